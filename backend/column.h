@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// A table of trivially copyable values, either built in memory or read in place from a mapped snapshot, see
+// Timetable::loadSnapshot. It has the parts of the std::vector interface that the timetable uses. Only a built column
+// may be changed, a mapped one points into read only memory.
+template <typename T>
+class Column {
+   public:
+    using value_type = T;
+
+    Column() = default;
+    Column(const Column& other) : owned(other.owned), mapped(other.mapped) { adopt(other); }
+    Column(Column&& other) noexcept : owned(std::move(other.owned)), mapped(other.mapped) {
+        adopt(other);
+        other.reset();
+    }
+    Column& operator=(const Column& other) {
+        owned = other.owned;
+        mapped = other.mapped;
+        adopt(other);
+        return *this;
+    }
+    Column& operator=(Column&& other) noexcept {
+        owned = std::move(other.owned);
+        mapped = other.mapped;
+        adopt(other);
+        other.reset();
+        return *this;
+    }
+
+    // Points the column at values, which must outlive it
+    void map(std::span<const T> values) {
+        owned = {};
+        mapped = true;
+        items = const_cast<T*>(values.data());
+        count = values.size();
+    }
+
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T* begin() { return items; }
+    const T* begin() const { return items; }
+    T* end() { return items + count; }
+    const T* end() const { return items + count; }
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+    const T& front() const { return items[0]; }
+    const T& back() const { return items[count - 1]; }
+
+    const T& at(size_t i) const {
+        if (i >= count) throw std::out_of_range("Column::at");
+        return items[i];
+    }
+
+    void clear() { update([](std::vector<T>& v) { v.clear(); }); }
+    void reserve(size_t n) { update([n](std::vector<T>& v) { v.reserve(n); }); }
+    void resize(size_t n) { update([n](std::vector<T>& v) { v.resize(n); }); }
+    void assign(size_t n, const T& value) { update([&](std::vector<T>& v) { v.assign(n, value); }); }
+    void push_back(const T& value) { update([&](std::vector<T>& v) { v.push_back(value); }); }
+
+   private:
+    // Changes the built values, after copying mapped ones over so the column can be changed
+    template <typename F>
+    void update(F&& change) {
+        if (mapped) owned.assign(items, items + count);
+        mapped = false;
+        change(owned);
+        items = owned.data();
+        count = owned.size();
+    }
+
+    void adopt(const Column& other) {
+        items = mapped ? other.items : owned.data();
+        count = other.count;
+    }
+
+    void reset() {
+        owned.clear();
+        mapped = false;
+        items = nullptr;
+        count = 0;
+    }
+
+    std::vector<T> owned;
+    bool mapped = false;
+    T* items = nullptr;
+    size_t count = 0;
+};
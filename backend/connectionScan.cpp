@@ -0,0 +1,321 @@
+// The Connection Scan Algorithm. Every departure of a trip from a stop is a connection, and a one-to-all search is a
+// single pass over the connections in order of departure. A trip is boarded at its first connection from a stop that
+// was reached in time, and is followed to its last stop right away, as arrivals only get earlier and a later stop
+// cannot board it any sooner. There is no queue, the state is a few vectors indexed by stop and by trip. Searches from
+// several starts share the pass, with the state of each start in a lane of those vectors.
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "routing.h"
+
+namespace routing {
+
+namespace {
+
+const uint32_t NOT_BOARDED = std::numeric_limits<uint32_t>::max();
+
+// How many starts the batched connectionScan searches from in one pass
+const size_t SCAN_LANES = 8;
+
+int32_t minTransferTime(const RoutingOptions& options, const StopNode& stop) {
+    return options.overrideMinTransferTime ? options.minTransferTime : stop.minTransferTime;
+}
+
+}  // namespace
+
+const Connections& Timetable::connections() const {
+    std::call_once(connectionsBuilt, [this] {
+        struct Departure {
+            int32_t time;
+            TripIdx trip;
+            uint32_t event;
+        };
+        std::vector<Departure> departures;
+        departures.reserve(events.size());
+        for (TripIdx trip = 1; trip < trips.size(); trip++) {
+            auto tripEventList = tripEvents(trip);
+            for (uint32_t event = 0; event + 1 < tripEventList.size(); event++) {
+                departures.push_back({tripEventList[event].departureTime, trip, event});
+            }
+        }
+        std::sort(departures.begin(), departures.end(), [](const Departure& a, const Departure& b) {
+            if (a.time != b.time) return a.time < b.time;
+            if (a.trip != b.trip) return a.trip < b.trip;
+            return a.event < b.event;
+        });
+
+        connectionColumns.departureTimes.reserve(departures.size());
+        connectionColumns.stops.reserve(departures.size());
+        connectionColumns.trips.reserve(departures.size());
+        connectionColumns.events.reserve(departures.size());
+        for (const Departure& d : departures) {
+            connectionColumns.departureTimes.push_back(d.time);
+            connectionColumns.stops.push_back(tripEvents(d.trip)[d.event].stop);
+            connectionColumns.trips.push_back(d.trip);
+            connectionColumns.events.push_back(d.event);
+        }
+    });
+    return connectionColumns;
+}
+
+std::vector<StopState> Timetable::connectionScan(StopIdx start, const RoutingOptions& options,
+                                                 const SearchLimits& limits, SearchCounters* counters) {
+    return std::move(connectionScanLanes<1>({&start, 1}, options, {&limits, 1}, counters)[0]);
+}
+
+std::vector<std::vector<StopState>> Timetable::connectionScan(std::span<const StopIdx> starts,
+                                                              const RoutingOptions& options,
+                                                              std::span<const SearchLimits> limits,
+                                                              SearchCounters* counters) {
+    std::vector<std::vector<StopState>> states;
+    states.reserve(starts.size());
+    for (size_t group = 0; group < starts.size(); group += SCAN_LANES) {
+        size_t size = std::min(SCAN_LANES, starts.size() - group);
+        auto groupStarts = starts.subspan(group, size);
+        auto groupLimits = limits.empty() ? limits : limits.subspan(group, size);
+        for (auto& state : connectionScanLanes<SCAN_LANES>(groupStarts, options, groupLimits, counters)) {
+            states.push_back(std::move(state));
+        }
+    }
+    return states;
+}
+
+// Each start has a lane, and the state of a stop or trip is Lanes values next to each other, so a connection that some
+// lane can board is checked for all of them at once, as a bitmask of lanes
+template <size_t Lanes>
+std::vector<std::vector<StopState>> Timetable::connectionScanLanes(std::span<const StopIdx> starts,
+                                                                   const RoutingOptions& options,
+                                                                   std::span<const SearchLimits> limits,
+                                                                   SearchCounters* counters) {
+    static_assert(Lanes <= 32, "lanes are a bitmask");
+    const Connections& scan = connections();
+    int32_t day = calendar.day(options.date);
+
+    // Stops are improved many times during a scan, so only the last way to each is kept, and the StopStates are made
+    // from them at the end. A stop can board trips from boardFrom on, its arrival plus its minimum transfer time.
+    struct Label {
+        int32_t arrival = std::numeric_limits<int32_t>::max();
+        int32_t initialWaitTime = 0;
+        uint32_t boardedAt = 0;  // event incoming.trip was boarded at
+        IncomingTrip incoming{NO_STOP, WALK, 0};
+    };
+    std::vector<Label> labels(stops.size() * Lanes);
+    std::vector<int32_t> boardFrom(stops.size() * Lanes, std::numeric_limits<int32_t>::max());
+
+    // From when and until when any lane can board at a stop, which rules out most connections with a read of less
+    // memory than the lanes take. The latest only ever grows, which just rules out fewer.
+    struct BoardRange {
+        int32_t earliest = std::numeric_limits<int32_t>::max();
+        int32_t latest = std::numeric_limits<int32_t>::min();
+    };
+    std::vector<BoardRange> boardRanges(Lanes > 1 ? stops.size() : 0);
+
+    // The earliest event each trip was boarded at, it has been followed from there to its end
+    std::vector<uint32_t> boardedAt(trips.size() * Lanes, NOT_BOARDED);
+
+    // Connections are only scanned while some stop can still board a trip
+    int32_t horizon = options.startTime;
+
+    // A connection arrives no earlier than it leaves, so once the scan is past doneAt of a lane, its arrivals up to
+    // then are final. That is the end of its bound, or the latest arrival at its targets once all of them are reached.
+    // The lane then takes no more connections, and its later arrivals are left out of the result.
+    std::array<int32_t, Lanes> doneAt;
+    doneAt.fill(std::numeric_limits<int32_t>::max());
+    std::array<size_t, Lanes> targetsLeft{};
+    std::vector<uint32_t> targetLanes(limits.empty() ? 0 : stops.size());  // bitmask of the lanes a stop is a target of
+    for (size_t lane = 0; lane < limits.size(); lane++) {
+        if (limits[lane].maxTravelTime != std::numeric_limits<int32_t>::max()) {
+            doneAt[lane] = static_cast<int32_t>(std::min<int64_t>(
+                std::numeric_limits<int32_t>::max(), int64_t{options.startTime} + limits[lane].maxTravelTime));
+        }
+        for (StopIdx target : limits[lane].targets) {
+            targetsLeft[lane] += !(targetLanes[target] >> lane & 1);
+            targetLanes[target] |= 1u << lane;
+        }
+    }
+    int32_t nextDone = *std::min_element(doneAt.begin(), doneAt.end());
+    uint32_t activeLanes = static_cast<uint32_t>((uint64_t{1} << starts.size()) - 1);
+
+    auto arrive = [&](size_t lane, StopIdx stop, int32_t time, int32_t initialWaitTime, uint32_t event,
+                      IncomingTrip incoming) {
+        Label& label = labels[stop * Lanes + lane];
+        if (time >= label.arrival) return false;
+        bool firstArrival = label.arrival == std::numeric_limits<int32_t>::max();
+        label = {time, initialWaitTime, event, incoming};
+        if (firstArrival && !targetLanes.empty() && (targetLanes[stop] >> lane & 1) && --targetsLeft[lane] == 0) {
+            int32_t latest = time;
+            for (StopIdx target : limits[lane].targets) {
+                latest = std::max(latest, labels[target * Lanes + lane].arrival);
+            }
+            doneAt[lane] = std::min(doneAt[lane], latest);
+            nextDone = std::min(nextDone, doneAt[lane]);
+        }
+        int32_t from = stop == starts[lane] ? time : time + minTransferTime(options, stops[stop]);
+        boardFrom[stop * Lanes + lane] = from;
+        if constexpr (Lanes > 1) {
+            boardRanges[stop].earliest = std::min(boardRanges[stop].earliest, from);
+            boardRanges[stop].latest = std::max(boardRanges[stop].latest, from);
+        }
+        horizon = std::max(horizon, from + options.searchTime);
+        return true;
+    };
+
+    // Transfers may be chained, like in dijkstra
+    std::vector<StopIdx> walkFrom;
+    auto walk = [&](size_t lane, StopIdx from) {
+        walkFrom.assign(1, from);
+        while (!walkFrom.empty()) {
+            StopIdx stop = walkFrom.back();
+            walkFrom.pop_back();
+            const Label& label = labels[stop * Lanes + lane];
+            for (const Edge& transfer : stops[stop].transfersType2) {
+                if (arrive(lane, transfer.to, label.arrival + transfer.cost, label.initialWaitTime, 0,
+                           IncomingTrip(stop, transfer.trip, transfer.stopSequence))) {
+                    walkFrom.push_back(transfer.to);
+                }
+            }
+        }
+    };
+
+    // Follows a trip from an event to its end, or to where it was boarded before. Trips that wait for it are boarded
+    // at the stops it arrives at without the minimum transfer time, see StopNode::transfersType1, and followed too.
+    struct Ride {
+        TripIdx trip;
+        uint32_t event;
+        int32_t initialWaitTime;
+    };
+    std::vector<Ride> rides;
+    auto ride = [&](size_t lane, TripIdx trip, uint32_t event, int32_t initialWaitTime) {
+        rides.assign(1, {trip, event, initialWaitTime});
+        while (!rides.empty()) {
+            Ride r = rides.back();
+            rides.pop_back();
+            uint32_t& tripBoardedAt = boardedAt[r.trip * Lanes + lane];
+            if (r.event >= tripBoardedAt) continue;
+            auto tripEventList = tripEvents(r.trip);
+            uint32_t end = tripBoardedAt == NOT_BOARDED ? tripEventList.size() : tripBoardedAt + 1;
+            tripBoardedAt = r.event;
+
+            for (uint32_t next = r.event + 1; next < end; next++) {
+                const StopEvent& arrival = tripEventList[next];
+                IncomingTrip incoming(tripEventList[next - 1].stop, r.trip, static_cast<int32_t>(next) + 1);
+                if (arrive(lane, arrival.stop, arrival.arrivalTime, r.initialWaitTime, r.event, incoming)) {
+                    walk(lane, arrival.stop);
+                }
+
+                // Few stops have trips waiting at them, so the lookup is skipped at most
+                if (stops[arrival.stop].transfersType1.empty()) continue;
+                auto transfers = stops[arrival.stop].transfersType1.find(r.trip);
+                if (transfers == stops[arrival.stop].transfersType1.end()) continue;
+                for (TripIdx toTrip : transfers->second) {
+                    if (!calendar.runs(trips[toTrip].calendar, day)) continue;
+                    auto toEvents = tripEvents(toTrip);
+                    uint32_t board = 0;
+                    while (board < toEvents.size() && (toEvents[board].stop != arrival.stop ||
+                                                       toEvents[board].departureTime < arrival.arrivalTime)) {
+                        board++;
+                    }
+                    while (board + 1 < toEvents.size() && toEvents[board + 1].stop == arrival.stop) board++;
+                    if (board + 1 < toEvents.size()) rides.push_back({toTrip, board, r.initialWaitTime});
+                }
+            }
+        }
+    };
+
+    for (size_t lane = 0; lane < starts.size(); lane++) {
+        arrive(lane, starts[lane], options.startTime, 0, 0, IncomingTrip(NO_STOP, WALK, 0));
+        walk(lane, starts[lane]);
+    }
+    if (day < 0) horizon = options.startTime;
+
+    // Most connections leave from stops that cannot board them, which only reads the time and stop columns. A lane can
+    // board from boardFrom up to the search time later, which is one unsigned compare.
+    auto window = static_cast<uint32_t>(options.searchTime);
+    auto first = std::lower_bound(scan.departureTimes.begin(), scan.departureTimes.end(), options.startTime);
+    for (size_t c = first - scan.departureTimes.begin(); c < scan.departureTimes.size(); c++) {
+        int32_t departureTime = scan.departureTimes[c];
+        if (departureTime >= horizon) break;
+        if (departureTime > nextDone) {
+            nextDone = std::numeric_limits<int32_t>::max();
+            for (size_t lane = 0; lane < starts.size(); lane++) {
+                if (departureTime > doneAt[lane]) activeLanes &= ~(1u << lane);
+                if (activeLanes >> lane & 1) nextDone = std::min(nextDone, doneAt[lane]);
+            }
+            if (activeLanes == 0) break;
+        }
+        StopIdx stop = scan.stops[c];
+        if constexpr (Lanes > 1) {
+            const BoardRange& range = boardRanges[stop];
+            if (departureTime < range.earliest || departureTime >= range.latest + options.searchTime) continue;
+        }
+        const int32_t* from = &boardFrom[stop * Lanes];
+        uint32_t lanes = 0;
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            lanes |= static_cast<uint32_t>(static_cast<uint32_t>(departureTime - from[lane]) < window) << lane;
+        }
+        lanes &= activeLanes;
+        if (lanes == 0) continue;
+
+        TripIdx trip = scan.trips[c];
+        uint32_t event = scan.events[c];
+        if (!calendar.runs(trips[trip].calendar, day)) continue;
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            if (!(lanes >> lane & 1) || boardedAt[trip * Lanes + lane] <= event) continue;
+            int32_t initialWaitTime = stop == starts[lane] ? departureTime - options.startTime
+                                                           : labels[stop * Lanes + lane].initialWaitTime;
+            ride(lane, trip, event, initialWaitTime);
+        }
+    }
+
+    std::vector<std::vector<StopState>> states(starts.size());
+    for (size_t lane = 0; lane < starts.size(); lane++) {
+        bool stoppedEarly = !(activeLanes >> lane & 1);
+        int32_t lastFinal = stoppedEarly ? doneAt[lane] : std::numeric_limits<int32_t>::max();
+        uint64_t settled = 0, pruned = 0;
+
+        std::vector<StopState>& state = states[lane];
+        state.resize(stops.size());
+        for (StopIdx stop = 0; stop < stops.size(); stop++) {
+            const Label& label = labels[stop * Lanes + lane];
+            if (label.arrival == std::numeric_limits<int32_t>::max()) continue;
+            if (label.arrival > lastFinal) {
+                pruned++;
+                continue;
+            }
+            settled++;
+            state[stop].travelTime = label.arrival - options.startTime;
+            state[stop].initialWaitTime = label.initialWaitTime;
+            state[stop].visited = true;
+            state[stop].incoming.push_back(label.incoming);
+        }
+
+        // The stops a trip passed on the way to a stop it was the fastest way to get an incoming trip for it, as in
+        // raptor
+        for (StopIdx stop = 0; stop < stops.size(); stop++) {
+            const Label& label = labels[stop * Lanes + lane];
+            if (label.incoming.trip == WALK || label.arrival > lastFinal) continue;
+            auto tripEventList = tripEvents(label.incoming.trip);
+            auto arrivedAt = static_cast<uint32_t>(label.incoming.stopSequence - 1);
+            for (uint32_t passed = label.boardedAt + 1; passed < arrivedAt; passed++) {
+                std::vector<IncomingTrip>& incoming = state[tripEventList[passed].stop].incoming;
+                if (std::none_of(incoming.begin(), incoming.end(),
+                                 [&label](const IncomingTrip& t) { return t.trip == label.incoming.trip; })) {
+                    incoming.emplace_back(tripEventList[passed - 1].stop, label.incoming.trip, passed + 1);
+                }
+            }
+        }
+        state[starts[lane]].incoming.clear();
+
+        if (counters != nullptr) {
+            counters->searches++;
+            counters->stoppedEarly += stoppedEarly;
+            counters->settledStops += settled;
+            counters->prunedStops += pruned;
+        }
+    }
+    return states;
+}
+
+}  // namespace routing
@@ -0,0 +1,315 @@
+#include "csvLoader.h"
+
+#include "zipArchive.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CSV_SIMD_SPLIT
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace csvLoader {
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (view != nullptr) {
+                    data = static_cast<const char*>(view);
+                    size = static_cast<size_t>(fileSize.QuadPart);
+                    fileHandle = file;
+                    mappingHandle = mapping;
+                    open = mapped = true;
+                    return;
+                }
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data = static_cast<const char*>(view);
+                size = static_cast<size_t>(st.st_size);
+                open = mapped = true;
+            }
+        }
+        ::close(fd);
+        if (mapped) return;
+    }
+#endif
+
+    // Empty files and files which cannot be mapped are read into memory instead
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return;
+    fallback.assign(std::istreambuf_iterator<char>{file}, {});
+    data = fallback.data();
+    size = fallback.size();
+    open = true;
+}
+
+MappedFile::~MappedFile() {
+    if (!mapped) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+#else
+    munmap(const_cast<char*>(data), size);
+#endif
+}
+
+RecordSource::RecordSource(const std::string& path) {
+    std::string archivePath, member;
+    if (!zip::splitPath(path, archivePath, member)) {
+        file = std::make_unique<MappedFile>(path);
+        return;
+    }
+
+    archive = std::make_unique<zip::Archive>(archivePath);
+    if (!archive->isOpen()) return;
+    if (const zip::Entry* entry = archive->find(member)) reader = std::make_unique<zip::Reader>(*archive, *entry);
+}
+
+RecordSource::~RecordSource() = default;
+
+bool RecordSource::isOpen() const { return file ? file->isOpen() : reader && !reader->failed(); }
+
+bool RecordSource::failed() const { return reader && reader->failed(); }
+
+namespace {
+// Length of the longest prefix of data which ends at the end of a record, or 0 if data does not contain a whole record
+size_t wholeRecords(std::string_view data) {
+    size_t quotes = std::count(data.begin(), data.end(), '"');
+    size_t end = data.size();
+    while (true) {
+        size_t nl = data.rfind('\n', end - 1);
+        if (nl == std::string_view::npos) return 0;
+        quotes -= std::count(data.begin() + nl, data.begin() + end, '"');
+        // Quotes before the newline are balanced, so it is not inside a quoted field
+        if (quotes % 2 == 0) return nl + 1;
+        if (nl == 0) return 0;
+        end = nl;
+    }
+}
+}  // namespace
+
+std::string_view RecordSource::next() {
+    if (done) return {};
+
+    if (file) {
+        done = true;
+        return file->view();
+    }
+
+    std::string_view stored = reader->stored();
+    if (!stored.empty()) {
+        done = true;
+        return stored;
+    }
+
+    // Keep the unfinished record at the end of the last block, and inflate until there is at least one whole record
+    buffer.erase(0, consumed);
+    while (true) {
+        if (reader->read(buffer, streamChunkSize) == 0) {
+            done = true;
+            if (reader->failed()) return {};
+            consumed = buffer.size();
+            return buffer;
+        }
+
+        consumed = wholeRecords(buffer);
+        if (consumed > 0) return std::string_view(buffer).substr(0, consumed);
+    }
+}
+
+namespace detail {
+#ifdef CSV_SIMD_SPLIT
+// The vector splitters work like simdjson and simdcsv: for every block of 16 or 32 bytes, bitmasks of the quotes,
+// commas and NUL bytes are built. A prefix xor over the quote mask gives which bytes are within quotes, and the
+// remaining commas and NULs are the field delimiters. The quote state is carried over between blocks, and the bytes
+// after the last whole block are handled by the scalar loop.
+
+static inline uint32_t prefixXor(uint32_t mask) {
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    return mask;
+}
+
+// Adds the fields ending at the delimiters in mask, where bit i is the byte at base + i. Returns false if a NUL byte
+// ended the line or maxFields fields have been found.
+static inline bool emitFields(std::string_view line, size_t base, uint32_t mask, size_t& start,
+                              std::vector<std::string_view>& fields, size_t maxFields) {
+    while (mask) {
+        size_t pos = base + __builtin_ctz(mask);
+        fields.push_back(line.substr(start, pos - start));
+        if (line[pos] == 0 || fields.size() == maxFields) return false;
+        start = pos + 1;
+        mask &= mask - 1;
+    }
+    return true;
+}
+
+// Splits from i onwards one byte at a time, continuing from the given state
+static inline void splitTail(std::string_view line, size_t i, size_t start, bool instr,
+                             std::vector<std::string_view>& fields, size_t maxFields) {
+    for (; i < line.size(); i++) {
+        char c = line[i];
+        if (c == '"') {
+            instr = !instr;
+        } else if (instr) {
+            continue;
+        } else if (c == ',' || c == 0) {
+            fields.push_back(line.substr(start, i - start));
+            if (c == 0 || fields.size() == maxFields) return;
+            start = i + 1;
+        }
+    }
+    fields.push_back(line.substr(start));
+}
+
+static void splitSse2(std::string_view line, std::vector<std::string_view>& fields, size_t maxFields) {
+    fields.clear();
+    if (maxFields == 0) return;
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t start = 0;
+    uint32_t instr = 0;
+    size_t i = 0;
+    for (; i + 16 <= line.size(); i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line.data() + i));
+        auto quotes = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, quote)));
+        auto delims = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, zero))));
+
+        uint32_t inside = (prefixXor(quotes) ^ (instr ? 0xFFFFu : 0u)) & 0xFFFFu;
+        instr ^= __builtin_popcount(quotes) & 1;
+
+        if (!emitFields(line, i, delims & ~inside, start, fields, maxFields)) return;
+    }
+    splitTail(line, i, start, instr, fields, maxFields);
+}
+
+__attribute__((target("avx2"))) static void splitAvx2(std::string_view line, std::vector<std::string_view>& fields,
+                                                      size_t maxFields) {
+    fields.clear();
+    if (maxFields == 0) return;
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t start = 0;
+    uint32_t instr = 0;
+    size_t i = 0;
+    for (; i + 32 <= line.size(); i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line.data() + i));
+        auto quotes = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, quote)));
+        auto delims = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, comma), _mm256_cmpeq_epi8(block, zero))));
+
+        uint32_t inside = prefixXor(quotes) ^ (instr ? 0xFFFFFFFFu : 0u);
+        instr ^= __builtin_popcount(quotes) & 1;
+
+        if (!emitFields(line, i, delims & ~inside, start, fields, maxFields)) return;
+    }
+    splitTail(line, i, start, instr, fields, maxFields);
+}
+#endif
+
+Splitter bestSplitter() {
+#ifdef CSV_SIMD_SPLIT
+    if (__builtin_cpu_supports("avx2")) return splitAvx2;
+    return splitSse2;
+#else
+    return splitScalar;
+#endif
+}
+
+const char* bestSplitterName() {
+#ifdef CSV_SIMD_SPLIT
+    if (__builtin_cpu_supports("avx2")) return "AVX2";
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+static bool oddNumberOfQuotes(std::string_view data) {
+    bool odd = false;
+    for (const char* q = data.data();
+         (q = static_cast<const char*>(std::memchr(q, '"', data.data() + data.size() - q))) != nullptr; q++) {
+        odd = !odd;
+    }
+    return odd;
+}
+
+// Returns the offset of the first record starting at or after from, given whether from is within quotes
+static size_t nextRecordStart(std::string_view data, size_t from, bool instr) {
+    for (size_t i = from; i < data.size(); i++) {
+        if (data[i] == '"') {
+            instr = !instr;
+        } else if (data[i] == '\n' && !instr) {
+            return i + 1;
+        }
+    }
+    return data.size();
+}
+
+std::vector<std::string_view> splitChunks(std::string_view data, size_t n) {
+    n = std::max<size_t>(1, std::min(n, data.size()));
+    size_t step = data.size() / n;
+
+    std::vector<char> oddQuotes(n);
+    threadPool::parallelFor(n, [&](size_t i) {
+        size_t end = i + 1 == n ? data.size() : (i + 1) * step;
+        oddQuotes[i] = oddNumberOfQuotes(data.substr(i * step, end - i * step));
+    });
+
+    std::vector<size_t> starts(n + 1);
+    bool instr = false;
+    for (size_t i = 1; i < n; i++) {
+        instr ^= static_cast<bool>(oddQuotes[i - 1]);
+        starts[i] = nextRecordStart(data, i * step, instr);
+    }
+    starts[n] = data.size();
+
+    std::vector<std::string_view> chunks;
+    for (size_t i = 0; i < n; i++) {
+        size_t start = std::min(starts[i], data.size());
+        size_t end = std::max(start, std::min(starts[i + 1], data.size()));
+        if (end > start) chunks.push_back(data.substr(start, end - start));
+    }
+    return chunks;
+}
+}  // namespace detail
+}  // namespace csvLoader
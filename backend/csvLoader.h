@@ -1,89 +1,200 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <chrono>
 #include <cstdint>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <typeinfo>
 #include <utility>
 #include <vector>
 
 #include "csvLoaderTypes.h"
+#include "threadPool.h"
 
 const auto haha_it_broke = EXIT_FAILURE;
 
+namespace zip {
+class Archive;
+class Reader;
+}  // namespace zip
+
 namespace csvLoader {
 
-static std::vector<std::string> split(const std::string& str) {
-    int i = 0;
-    int ptr = 0;
-    char c;
+// Read-only view of a whole file. The file is memory mapped when possible, otherwise it is read into memory, so that
+// the parser can hand out string_views into the file contents without copying anything.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] bool isOpen() const { return open; }
+    [[nodiscard]] std::string_view view() const { return {data, size}; }
+
+   private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool open = false;
+    bool mapped = false;
+    std::string fallback;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// Splits a line into fields. Commas within quotes do not split, and the quotes are kept in the field. The fields are
+// views into the line, and the vector is reused between lines so no allocation is done per line. At most maxFields
+// fields are split out, the rest of the line is not looked at.
+inline void splitScalar(std::string_view line, std::vector<std::string_view>& fields,
+                        size_t maxFields = std::string_view::npos) {
+    fields.clear();
+    if (maxFields == 0) return;
+    size_t start = 0;
     bool instr = false;
-    std::vector<std::string> acc;
-    while (true) {
-        while ((c = str[ptr++]) != ',' && c != 0 && c != '"')
-            ;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
         if (c == '"') {
             instr = !instr;
+        } else if (instr) {
             continue;
+        } else if (c == ',') {
+            fields.push_back(line.substr(start, i - start));
+            if (fields.size() == maxFields) return;
+            start = i + 1;
+        } else if (c == 0) {
+            fields.push_back(line.substr(start, i - start));
+            return;
         }
-        if (instr) {
-            continue;
+    }
+    fields.push_back(line.substr(start));
+}
+
+namespace detail {
+using Splitter = void (*)(std::string_view, std::vector<std::string_view>&, size_t);
+
+// Returns the fastest splitter the CPU supports. All of them give exactly the same fields as splitScalar.
+Splitter bestSplitter();
+
+// Name of the splitter returned by bestSplitter, for benchmarks
+const char* bestSplitterName();
+}  // namespace detail
+
+// Same as splitScalar, but looks for delimiters and quotes 16 or 32 bytes at a time when the CPU supports it
+inline void split(std::string_view line, std::vector<std::string_view>& fields,
+                  size_t maxFields = std::string_view::npos) {
+    static const detail::Splitter splitter = detail::bestSplitter();
+    splitter(line, fields, maxFields);
+}
+
+// Returns the length of the record starting at the beginning of data, not including the newline. A record ends at the
+// first newline which is not within quotes, or at the end of the data.
+inline size_t recordLength(std::string_view data) {
+    size_t end = 0;
+    bool instr = false;
+    while (true) {
+        const void* nl = std::memchr(data.data() + end, '\n', data.size() - end);
+        size_t lineEnd = nl ? static_cast<const char*>(nl) - data.data() : data.size();
+
+        for (const char* q = data.data() + end;
+             (q = static_cast<const char*>(std::memchr(q, '"', data.data() + lineEnd - q))) != nullptr; q++) {
+            instr = !instr;
         }
-        acc.push_back(str.substr(i, ptr - i - 1));
-        i = ptr;
-        if (c == 0) break;
+
+        if (!instr || lineEnd == data.size()) return lineEnd;
+        end = lineEnd + 1;
+    }
+}
+
+// Calls f with every record (line) in data, without the trailing newline. Like std::getline, a trailing newline at the
+// end of the data does not produce an empty last record.
+template <typename F>
+void forEachRecord(std::string_view data, F&& f) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t len = recordLength(data.substr(pos));
+        if (!f(data.substr(pos, len))) return;
+        pos += len + 1;
     }
-    return acc;
 }
 
-inline uint64_t parseu64(const std::string& str) {
-    if (str.empty() || str == "\r") return 0;
-    return std::stoull(str);
-    static_assert(sizeof(unsigned long long) == sizeof(uint64_t));
+template <typename T>
+inline T parseInteger(std::string_view str) {
+    T value = 0;
+    std::from_chars(str.data(), str.data() + str.size(), value);
+    return value;
 }
 
-inline int parseInt(const std::string& str) {
-    if (str.empty() || str == "\r") return 0;
-    return std::stoi(str);
+inline uint64_t parseu64(std::string_view str) { return parseInteger<uint64_t>(str); }
+
+inline int parseInt(std::string_view str) {
+    return parseInteger<int>(str);
     static_assert(sizeof(int) == sizeof(int32_t));
 }
 
-inline double parseDouble(const std::string& str) {
-    if (str.empty() || str == "\r") return 0;
-    return std::stod(str);
+inline double parseDouble(std::string_view str) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    double value = 0;
+    std::from_chars(str.data(), str.data() + str.size(), value);
+    return value;
+#else
+    // strtod needs a terminated string, and fields are views into the file, so copy to the stack first
+    std::array<char, 64> buf{};
+    if (str.empty() || str.size() >= buf.size()) return 0;
+    std::memcpy(buf.data(), str.data(), str.size());
+    return std::strtod(buf.data(), nullptr);
+#endif
 }
 
-inline float parseFloat(const std::string& str) {
-    if (str.empty() || str == "\r") return 0;
-    return std::stof(str);
+inline float parseFloat(std::string_view str) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    float value = 0;
+    std::from_chars(str.data(), str.data() + str.size(), value);
+    return value;
+#else
+    return static_cast<float>(parseDouble(str));
+#endif
 }
 
-inline bool parseBool(const std::string& str) { return !parseInt(str); }
+inline bool parseBool(std::string_view str) { return parseInt(str) != 0; }
+
+inline int32_t twoDigits(const char* p) { return (p[0] - '0') * 10 + (p[1] - '0'); }
 
-static Date parseDate(const std::string& str) {
-    int32_t original = std::stoi(str);
-    uint16_t year = static_cast<uint16_t>(std::stoi(str.substr(0, 4)));
-    uint8_t month = static_cast<uint8_t>(std::stoi(str.substr(4, 2)));
-    uint8_t day = static_cast<uint8_t>(std::stoi(str.substr(6, 2)));
-    return {original, year, month, day};
+// YYYYMMDD
+static Date parseDate(std::string_view str) {
+    if (str.size() < 8) return {parseInt(str), 0, 0, 0};
+    auto year = static_cast<uint16_t>(twoDigits(str.data()) * 100 + twoDigits(str.data() + 2));
+    auto month = static_cast<uint8_t>(twoDigits(str.data() + 4));
+    auto day = static_cast<uint8_t>(twoDigits(str.data() + 6));
+    return {year * 10000 + month * 100 + day, year, month, day};
 }
 
-static Time parseTime(const std::string& str) {
-    std::stringstream ss(str);
-    int32_t h, m, s;
-    char c;
-    ss >> h >> c >> m >> c >> s;
+// H:MM:SS or HH:MM:SS, where the hours may go past 24 for trips running after midnight
+static Time parseTime(std::string_view str) {
+    size_t colon = str.find(':');
+    if (colon == std::string_view::npos || str.size() < colon + 6) return Time{0};
+
+    int32_t h = parseInteger<int32_t>(str.substr(0, colon));
+    int32_t m = twoDigits(str.data() + colon + 1);
+    int32_t s = twoDigits(str.data() + colon + 4);
     return Time{h * 60 * 60 + m * 60 + s};
 }
 
 template <typename T>
-T parse(const std::string& str) {
+T parse(std::string_view str) {
     if constexpr (std::is_same_v<T, std::string>) {
-        return str;
+        return std::string(str);
     } else if constexpr (std::is_same_v<T, bool>) {
         return parseBool(str);
     } else if constexpr (std::is_same_v<T, uint64_t>) {
@@ -106,37 +217,420 @@ T parse(const std::string& str) {
     }
 }
 
-template <typename R, typename... Args>
-std::vector<R> load(const std::string& path, bool skipHeader = true) {
-    std::string line;
-    std::ifstream file;
-    file.open(path);
+// Names of the columns to load, one for every field type. The columns are looked up in the header of the file, so
+// the order of the columns in the file does not matter and columns which are not asked for are never parsed. Fields of
+// type Ignore are not looked up at all.
+template <size_t N>
+using Columns = std::array<std::string_view, N>;
 
-    if (!file.is_open()) {
-        std::cerr << "[ERROR!] Could not open file " << path << std::endl;
-        return {};
-    }
+namespace detail {
+// Which fields to parse out of every line of a file
+template <size_t N>
+struct Projection {
+    std::array<int32_t, N> index{};  // column of every field, or -1 if the file does not have it
+    size_t fieldsNeeded = N;         // fewest fields a line may have, up to the last loaded one
+    size_t headerFields = N;         // fields in the header, the most a line may have
+    bool byHeader = false;           // if false, every line must have exactly N fields, which are taken in order
+};
 
-    std::vector<R> acc;
+template <size_t N>
+Projection<N> positional() {
+    Projection<N> projection;
+    for (size_t i = 0; i < N; i++) projection.index[i] = static_cast<int32_t>(i);
+    return projection;
+}
+
+inline std::string_view trimHeaderName(std::string_view name) {
+    if (name.starts_with("\xEF\xBB\xBF")) name.remove_prefix(3);  // UTF-8 byte order mark
+    if (name.ends_with('\r')) name.remove_suffix(1);
+    if (name.size() >= 2 && name.front() == '"' && name.back() == '"') name = name.substr(1, name.size() - 2);
+    return name;
+}
+
+// Looks up the columns in the header line. Missing columns are parsed as empty fields, with a warning.
+template <typename... Args>
+Projection<sizeof...(Args)> project(std::string_view header, const Columns<sizeof...(Args)>& columns,
+                                    const std::string& name) {
+    std::vector<std::string_view> names;
+    split(header, names);
+    for (auto& headerName : names) headerName = trimHeaderName(headerName);
 
-    while (getline(file, line)) {
-        if (skipHeader) {
-            skipHeader = false;
+    Projection<sizeof...(Args)> projection;
+    projection.byHeader = true;
+    projection.fieldsNeeded = 0;
+    projection.headerFields = names.size();
+    constexpr std::array<bool, sizeof...(Args)> ignored = {std::is_same_v<Args, Ignore>...};
+
+    for (size_t i = 0; i < columns.size(); i++) {
+        projection.index[i] = -1;
+        if (ignored[i]) continue;
+
+        auto found = std::find(names.begin(), names.end(), columns[i]);
+        if (found == names.end()) {
+            std::cerr << "[WARNING] Column " << columns[i] << " not found, leaving it empty (file:" << name << ")"
+                      << std::endl;
             continue;
         }
+        projection.index[i] = static_cast<int32_t>(found - names.begin());
+        projection.fieldsNeeded = std::max(projection.fieldsNeeded, static_cast<size_t>(projection.index[i]) + 1);
+    }
+    return projection;
+}
+
+// Parses a field found by header. Quoted fields are unquoted first.
+template <typename T>
+T parseField(std::string_view field) {
+    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+        field = field.substr(1, field.size() - 2);
+        if constexpr (std::is_same_v<T, std::string>) {
+            if (field.find("\"\"") != std::string_view::npos) {
+                std::string unescaped;
+                for (size_t i = 0; i < field.size(); i++) {
+                    unescaped.push_back(field[i]);
+                    if (field[i] == '"' && i + 1 < field.size() && field[i + 1] == '"') i++;
+                }
+                return unescaped;
+            }
+        }
+    }
+    return parse<T>(field);
+}
 
-        auto vals = split(line);
+// Parses every record in data and calls callback with the fields parsed as Args. Returns false, after printing an
+// error, if a line has the wrong number of fields. Lines of files read by header are skipped instead, and reported
+// once for the whole of data.
+template <typename... Args, typename F>
+bool visitRecords(std::string_view data, const std::string& name, const Projection<sizeof...(Args)>& projection,
+                  F&& callback) {
+    std::vector<std::string_view> vals;
+    bool ok = true;
+    size_t skipped = 0;
+    std::string_view firstSkipped;
+
+    forEachRecord(data, [&](std::string_view line) {
         constexpr size_t n = sizeof...(Args);
+
+        if (projection.byHeader) {
+            if (line.ends_with('\r')) line.remove_suffix(1);
+            if (line.empty()) return true;
+
+            // A line must have the fields of the header. Trailing fields may be left out if none of them are loaded,
+            // they are empty then, but a line that is cut short or has fields too many would be parsed wrong.
+            split(line, vals, projection.headerFields + 1);
+            if (vals.size() < projection.fieldsNeeded || vals.size() > projection.headerFields) {
+                if (skipped++ == 0) firstSkipped = line;
+                return true;
+            }
+
+            [&]<std::size_t... Idx>(std::index_sequence<Idx...>) {
+                callback(parseField<Args>(projection.index[Idx] < 0 ? std::string_view{}
+                                                                     : vals[projection.index[Idx]])...);
+            }
+            (std::make_index_sequence<n>{});
+            return true;
+        }
+
+        split(line, vals);
         if (vals.size() != n) {
-            std::cerr << "[ERROR!] Line does not contain " << n << " elements: " << line << " (file:" << path << ")"
+            std::cerr << "[ERROR!] Line does not contain " << n << " elements: " << line << " (file:" << name << ")"
                       << std::endl;
-            return {};
+            return ok = false;
+        }
+
+        [&]<std::size_t... Idx>(std::index_sequence<Idx...>) { callback(parse<Args>(vals[Idx])...); }
+        (std::make_index_sequence<n>{});
+        return true;
+    });
+
+    if (skipped > 0) {
+        std::cerr << "[ERROR!] Skipped " << skipped << " lines without " << projection.headerFields
+                  << " fields like the header, the first: " << firstSkipped << " (file:" << name << ")" << std::endl;
+    }
+    return ok;
+}
+
+// Parses every record in data into an R constructed from the fields parsed as Args, appending them to acc. name is
+// only used in error messages. Returns false if a line has the wrong number of fields.
+template <typename R, typename... Args>
+bool parseRecords(std::string_view data, const std::string& name, const Projection<sizeof...(Args)>& projection,
+                  std::vector<R>& acc) {
+    return visitRecords<Args...>(data, name, projection, [&acc](auto&&... vals) {
+        acc.emplace_back(std::forward<decltype(vals)>(vals)...);
+    });
+}
+
+// Splits data into at most n ranges which all start at the beginning of a record, so that every range can be parsed
+// on its own. Quotes are taken into account by first counting them in every range in parallel, so the quote state at
+// the start of each range is known when looking for the first newline after it.
+std::vector<std::string_view> splitChunks(std::string_view data, size_t n);
+
+// Splits off the header line of data
+inline std::string_view skipLine(std::string_view& data) {
+    size_t headerLength = recordLength(data);
+    std::string_view header = data.substr(0, headerLength);
+    data = data.substr(std::min(headerLength + 1, data.size()));
+    return header;
+}
+
+// Where the body of the file starts and how to parse it, either positionally or by the given columns
+template <typename... Args>
+std::pair<std::string_view, Projection<sizeof...(Args)>> prepare(std::string_view data, bool skipHeader) {
+    if (skipHeader) skipLine(data);
+    return {data, positional<sizeof...(Args)>()};
+}
+
+template <typename... Args>
+std::pair<std::string_view, Projection<sizeof...(Args)>> prepare(std::string_view data,
+                                                                 const Columns<sizeof...(Args)>& columns,
+                                                                 const std::string& name) {
+    std::string_view header = skipLine(data);
+    return {data, project<Args...>(header, columns, name)};
+}
+}  // namespace detail
+
+// Files smaller than this are not worth splitting up
+constexpr size_t parallelThreshold = 1 << 20;
+
+// Size of the chunks forEach parses ahead on the thread pool. At most one chunk per thread is held in memory at once.
+constexpr size_t streamChunkSize = 4 << 20;
+
+namespace detail {
+template <typename R, typename... Args>
+std::vector<R> loadBody(std::string_view body, const std::string& name, const Projection<sizeof...(Args)>& projection) {
+    std::vector<R> acc;
+    if (!parseRecords<R, Args...>(body, name, projection, acc)) return {};
+    return acc;
+}
+
+// Parallel version of parseRecords. The data is split into newline aligned chunks which are parsed on the thread pool,
+// then appended to acc in file order.
+template <typename R, typename... Args>
+bool parallelParseRecords(std::string_view body, const std::string& name, const Projection<sizeof...(Args)>& projection,
+                          std::vector<R>& acc) {
+    if (body.size() < parallelThreshold || threadPool::size() == 1) {
+        return parseRecords<R, Args...>(body, name, projection, acc);
+    }
+
+    auto chunks = splitChunks(body, threadPool::size() * 4);
+    std::vector<std::vector<R>> parsed(chunks.size());
+    std::vector<char> ok(chunks.size());
+
+    threadPool::parallelFor(chunks.size(), [&](size_t i) {
+        parsed[i].reserve(std::count(chunks[i].begin(), chunks[i].end(), '\n') + 1);
+        ok[i] = parseRecords<R, Args...>(chunks[i], name, projection, parsed[i]);
+    });
+
+    if (std::find(ok.begin(), ok.end(), false) != ok.end()) return false;
+
+    size_t total = acc.size();
+    for (const auto& chunk : parsed) total += chunk.size();
+
+    acc.reserve(total);
+    for (size_t i = 0; i < parsed.size(); i++) {
+        acc.insert(acc.end(), std::make_move_iterator(parsed[i].begin()), std::make_move_iterator(parsed[i].end()));
+        std::vector<R>().swap(parsed[i]);
+    }
+    return true;
+}
+
+template <typename... Args, typename F>
+bool forEachBody(std::string_view body, const std::string& name, const Projection<sizeof...(Args)>& projection,
+                 F&& callback) {
+    if (body.size() < parallelThreshold || threadPool::size() == 1) {
+        return visitRecords<Args...>(body, name, projection, callback);
+    }
+
+    auto chunks = splitChunks(body, (body.size() + streamChunkSize - 1) / streamChunkSize);
+    size_t wave = threadPool::size();
+    std::vector<std::vector<std::tuple<Args...>>> parsed(wave);
+    std::vector<char> ok(wave);
+
+    for (size_t first = 0; first < chunks.size(); first += wave) {
+        size_t n = std::min(wave, chunks.size() - first);
+        threadPool::parallelFor(n, [&](size_t i) {
+            parsed[i].clear();
+            ok[i] = parseRecords<std::tuple<Args...>, Args...>(chunks[first + i], name, projection, parsed[i]);
+        });
+
+        for (size_t i = 0; i < n; i++) {
+            for (auto& row : parsed[i]) std::apply(callback, std::move(row));
+            if (!ok[i]) return false;
         }
+    }
+    return true;
+}
+}  // namespace detail
+
+// Parses every record in data into an R, constructed from the fields parsed as Args. name is only used in error
+// messages. The fields are taken in order, and every line must have exactly as many fields as there are Args, otherwise
+// an empty vector is returned.
+template <typename R, typename... Args>
+std::vector<R> loadBuffer(std::string_view data, const std::string& name, bool skipHeader = true) {
+    auto [body, projection] = detail::prepare<Args...>(data, skipHeader);
+    return detail::loadBody<R, Args...>(body, name, projection);
+}
+
+// Same as above, but the fields are taken from the named columns of the header
+template <typename R, typename... Args>
+std::vector<R> loadBuffer(std::string_view data, const std::string& name, const Columns<sizeof...(Args)>& columns) {
+    auto [body, projection] = detail::prepare<Args...>(data, columns, name);
+    return detail::loadBody<R, Args...>(body, name, projection);
+}
+
+// Same as loadBuffer, but the data is split into newline aligned chunks which are parsed on the thread pool. The
+// result is in the same order as in the file.
+template <typename R, typename... Args>
+std::vector<R> parallelLoadBuffer(std::string_view data, const std::string& name, bool skipHeader = true) {
+    auto [body, projection] = detail::prepare<Args...>(data, skipHeader);
+    std::vector<R> acc;
+    if (!detail::parallelParseRecords<R, Args...>(body, name, projection, acc)) return {};
+    return acc;
+}
+
+template <typename R, typename... Args>
+std::vector<R> parallelLoadBuffer(std::string_view data, const std::string& name,
+                                  const Columns<sizeof...(Args)>& columns) {
+    auto [body, projection] = detail::prepare<Args...>(data, columns, name);
+    std::vector<R> acc;
+    if (!detail::parallelParseRecords<R, Args...>(body, name, projection, acc)) return {};
+    return acc;
+}
+
+// Calls callback with the fields of every record in data parsed as Args, in order, without building a vector of all
+// rows. Chunks of the data are parsed ahead on the thread pool a few at a time, while the callback is always called on
+// the calling thread. Returns false if a line has the wrong number of fields, in which case the rows before it have
+// already been passed to the callback.
+template <typename... Args, typename F>
+bool forEachBuffer(std::string_view data, const std::string& name, F&& callback, bool skipHeader = true) {
+    auto [body, projection] = detail::prepare<Args...>(data, skipHeader);
+    return detail::forEachBody<Args...>(body, name, projection, std::forward<F>(callback));
+}
+
+template <typename... Args, typename F>
+bool forEachBuffer(std::string_view data, const std::string& name, const Columns<sizeof...(Args)>& columns,
+                   F&& callback) {
+    auto [body, projection] = detail::prepare<Args...>(data, columns, name);
+    return detail::forEachBody<Args...>(body, name, projection, std::forward<F>(callback));
+}
 
-        [&]<std::size_t... Idx>(std::index_sequence<Idx...>) { acc.emplace_back(parse<Args>(vals[Idx])...); }
-        (std::make_index_sequence<sizeof...(Args)>{});
+// Reads the file at path a block of whole records at a time. Plain files are memory mapped and read as one block.
+// Members of zip archives are inflated about streamChunkSize at a time, so only one block of the member is held in
+// memory at once.
+class RecordSource {
+   public:
+    explicit RecordSource(const std::string& path);
+    ~RecordSource();
+
+    RecordSource(const RecordSource&) = delete;
+    RecordSource& operator=(const RecordSource&) = delete;
+
+    [[nodiscard]] bool isOpen() const;
+
+    // The next block of the file, ending at the end of a record. The view is valid until the next call. Returns an
+    // empty view once the whole file has been read, or if reading failed.
+    std::string_view next();
+
+    // Set if a zip member turned out to be corrupt part way through
+    [[nodiscard]] bool failed() const;
+
+   private:
+    std::unique_ptr<MappedFile> file;
+    std::unique_ptr<zip::Archive> archive;
+    std::unique_ptr<zip::Reader> reader;
+    std::string buffer;
+    size_t consumed = 0;
+    bool done = false;
+};
+
+namespace detail {
+// Parses the header of the first block of path, either by skipping it or by looking up columns in it, and calls
+// parse(body, projection) for every block. Returns false if the file could not be read or parse returned false.
+template <typename... Args, typename Header, typename Parse>
+bool parseFile(const std::string& path, const Header& header, Parse&& parse) {
+    RecordSource source(path);
+
+    if (!source.isOpen()) {
+        std::cerr << "[ERROR!] Could not open file " << path << std::endl;
+        return false;
     }
 
+    auto [body, projection] = [&] {
+        if constexpr (std::is_same_v<Header, bool>) {
+            return prepare<Args...>(source.next(), header);
+        } else {
+            return prepare<Args...>(source.next(), header, path);
+        }
+    }();
+
+    do {
+        if (!parse(body, projection)) return false;
+        body = source.next();
+    } while (!body.empty());
+
+    if (source.failed()) {
+        std::cerr << "[ERROR!] Could not read all of file " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename R, typename... Args, typename Header>
+std::vector<R> loadFile(const std::string& path, const Header& header) {
+    std::vector<R> acc;
+    bool ok = parseFile<Args...>(path, header, [&](std::string_view body, const auto& projection) {
+        return parseRecords<R, Args...>(body, path, projection, acc);
+    });
+    if (!ok) return {};
+    return acc;
+}
+
+template <typename R, typename... Args, typename Header>
+std::vector<R> parallelLoadFile(const std::string& path, const Header& header) {
+    std::vector<R> acc;
+    bool ok = parseFile<Args...>(path, header, [&](std::string_view body, const auto& projection) {
+        return parallelParseRecords<R, Args...>(body, path, projection, acc);
+    });
+    if (!ok) return {};
     return acc;
 }
+}  // namespace detail
+
+// The functions below are the same as the buffer versions above, but for the file at path. path may also name a member
+// of a zip archive, like "data/gtfs/feed.zip/stops.txt", which is then inflated and parsed a block at a time.
+
+template <typename R, typename... Args>
+std::vector<R> load(const std::string& path, bool skipHeader = true) {
+    return detail::loadFile<R, Args...>(path, skipHeader);
+}
+
+template <typename R, typename... Args>
+std::vector<R> load(const std::string& path, const Columns<sizeof...(Args)>& columns) {
+    return detail::loadFile<R, Args...>(path, columns);
+}
+
+// Parallel version of load, for files with millions of rows
+template <typename R, typename... Args>
+std::vector<R> parallelLoad(const std::string& path, bool skipHeader = true) {
+    return detail::parallelLoadFile<R, Args...>(path, skipHeader);
+}
+
+template <typename R, typename... Args>
+std::vector<R> parallelLoad(const std::string& path, const Columns<sizeof...(Args)>& columns) {
+    return detail::parallelLoadFile<R, Args...>(path, columns);
+}
+
+// Streaming version of load, see forEachBuffer. Returns false if the file could not be opened or parsed.
+template <typename... Args, typename F>
+bool forEach(const std::string& path, F&& callback, bool skipHeader = true) {
+    return detail::parseFile<Args...>(path, skipHeader, [&](std::string_view body, const auto& projection) {
+        return detail::forEachBody<Args...>(body, path, projection, callback);
+    });
+}
+
+template <typename... Args, typename F>
+bool forEach(const std::string& path, const Columns<sizeof...(Args)>& columns, F&& callback) {
+    return detail::parseFile<Args...>(path, columns, [&](std::string_view body, const auto& projection) {
+        return detail::forEachBody<Args...>(body, path, projection, callback);
+    });
+}
 }  // namespace csvLoader
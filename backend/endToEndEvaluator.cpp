@@ -1,5 +1,6 @@
 #include "endToEndEvaluator.h"
 
+#include <algorithm>
 #include <sstream>
 #include <utility>
 
@@ -7,34 +8,32 @@
 
 using namespace routing;
 
-static void extractShape(Timetable& tt, StopId to, std::unordered_map<StopId, StopState>& graph,
+static void extractShape(Timetable& tt, StopIdx to, std::vector<StopState>& graph,
                          std::unordered_map<SegmentId, E2EE::ShapeSegment>& segments,
-                         std::unordered_map<StopId, int32_t>& transfers, uint64_t& numberOfTransfers) {
-    if (graph.find(to) == graph.end()) return;
-
+                         std::unordered_map<StopIdx, int32_t>& transfers, uint64_t& numberOfTransfers) {
     StopState* current = &graph.at(to);
     if (current->incoming.empty()) return;
 
-    TripId currentTrip = current->incoming.front().tripId;
-    StopId currentId = to;
+    TripIdx currentTrip = current->incoming.front().trip;
+    StopIdx currentId = to;
 
     while (!current->incoming.empty()) {
         // we came from "from" and are going to "current"
         IncomingTrip from = current->incoming[0];
         for (const IncomingTrip& node : current->incoming) {
-            if (node.tripId == currentTrip && currentTrip != WALK) {
+            if (node.trip == currentTrip && currentTrip != WALK) {
                 from = node;
                 break;
             }
         }
 
-        if (from.tripId != currentTrip) {
+        if (from.trip != currentTrip) {
             if (currentTrip != WALK) numberOfTransfers++;
             transfers[currentId]++;
         }
 
-        if (from.tripId != WALK) {
-            Trip& trip = tt.trips[from.tripId];
+        if (from.trip != WALK) {
+            Trip& trip = tt.trips[from.trip];
             SegmentId segmentId = trip.routeId + from.stopSequence * 10 + trip.directionId;
 
             auto iter = segments.find(segmentId);
@@ -43,12 +42,14 @@ static void extractShape(Timetable& tt, StopId to, std::unordered_map<StopId, St
             } else {
                 int32_t startIdx, endIdx;
 
-                StopTime& start = trip.stopTimes[from.stopSequence - 2];
-                StopTime& end = trip.stopTimes[from.stopSequence - 1];
+                uint32_t start = tt.eventIndex(from.trip, from.stopSequence - 1);
+                uint32_t end = tt.eventIndex(from.trip, from.stopSequence);
+                double startDistance = tt.eventShapeDistTravelled[start];
+                double endDistance = tt.eventShapeDistTravelled[end];
 
-                auto& shape = tt.shapes.at(trip.shapeId);
+                auto shape = tt.shapes.points(trip.shapeId);
 
-                if (end.shapeDistTravelled == 0 && start.shapeDistTravelled == 0) {
+                if (endDistance == 0 && startDistance == 0) {
                     auto sqDist = [](DMSCoord& a, DMSCoord& b) {
                         double deltaLat = a.latitude - b.latitude;
                         double deltaLon = a.longitude - b.longitude;
@@ -61,11 +62,11 @@ static void extractShape(Timetable& tt, StopId to, std::unordered_map<StopId, St
                         };
                     };
 
-                    auto& startCoord = tt.stopPoints.at(start.stopPoint);
+                    auto& startCoord = tt.stopPoints.at(tt.eventStopPoints[start]);
                     auto startPoint = std::min_element(shape.begin(), shape.end(), findClosestPoint(startCoord));
                     startIdx = (int32_t)std::distance(shape.begin(), startPoint);
 
-                    auto& endCoord = tt.stopPoints.at(end.stopPoint);
+                    auto& endCoord = tt.stopPoints.at(tt.eventStopPoints[end]);
                     auto endPoint = std::min_element(shape.begin() + startIdx, shape.end(), findClosestPoint(endCoord));
                     endIdx = (int32_t)std::distance(shape.begin(), endPoint) + 1;
                 } else {
@@ -73,52 +74,54 @@ static void extractShape(Timetable& tt, StopId to, std::unordered_map<StopId, St
                         return a.first < b.first;
                     };
 
+                    // Shape distances are stored rounded, so the stop distances are rounded the same way
+                    startDistance = ShapeStore::roundDistance(startDistance);
+                    endDistance = ShapeStore::roundDistance(endDistance);
+
                     auto startBound = std::lower_bound(
-                        shape.begin(), shape.end(), std::make_pair(start.shapeDistTravelled, DMSCoord(0, 0)), compare);
+                        shape.begin(), shape.end(), std::make_pair(startDistance, DMSCoord(0, 0)), compare);
                     startIdx = (int32_t)std::distance(shape.begin(), startBound);
 
                     auto endBound = std::upper_bound(shape.begin(), shape.end(),
-                                                     std::make_pair(end.shapeDistTravelled, DMSCoord(0, 0)), compare);
+                                                     std::make_pair(endDistance, DMSCoord(0, 0)), compare);
                     endIdx = (int32_t)std::distance(shape.begin(), endBound);
                 }
 
-                segments[segmentId] = {from.from->stopId, currentId, from.tripId, startIdx, endIdx, from.stopSequence};
+                segments[segmentId] = {from.from, currentId, from.trip, startIdx, endIdx, from.stopSequence};
             }
         } else {
-            SegmentId segmentId = from.from->stopId ^ (currentId << 32);
+            SegmentId segmentId = from.from ^ (static_cast<SegmentId>(currentId) << 32);
 
             auto iter = segments.find(segmentId);
             if (iter != segments.end()) {
                 iter->second.passengerCount++;
             } else {
-                segments[segmentId] = {from.from->stopId, currentId, WALK, 0, 0, 0};
+                segments[segmentId] = {from.from, currentId, WALK, 0, 0, 0};
             }
         }
 
-        currentTrip = from.tripId;
-        currentId = from.from->stopId;
+        currentTrip = from.trip;
+        currentId = from.from;
         current = &graph[currentId];
     }
 }
 
-std::vector<StopId> extractPath(Timetable& timetable, StopId stopId, std::unordered_map<StopId, StopState>& graph) {
-    if (graph.find(stopId) == graph.end()) return {};
-
+std::vector<StopIdx> extractPath(Timetable& timetable, StopIdx stopId, std::vector<StopState>& graph) {
     StopState* current = &graph.at(stopId);
     if (current->incoming.empty()) return {};
 
-    TripId currentTrip = current->incoming.front().tripId;
-    std::vector<StopId> legs;
+    TripIdx currentTrip = current->incoming.front().trip;
+    std::vector<StopIdx> legs;
     legs.push_back(stopId);
 
     while (!current->incoming.empty()) {
         for (const IncomingTrip& node : current->incoming) {
-            if (node.tripId == currentTrip && currentTrip != WALK) {
-                legs.push_back(node.from->stopId);
+            if (node.trip == currentTrip && currentTrip != WALK) {
+                legs.push_back(node.from);
                 break;
             }
         }
-        StopId fromStopId = current->incoming[0].from->stopId;
+        StopIdx fromStopId = current->incoming[0].from;
         legs.push_back(fromStopId);
         current = &graph[fromStopId];
     }
@@ -158,7 +161,7 @@ E2EE::Stats E2EE::evaluatePerformanceAtPoint(MeterCoord origin, E2EE::Options op
     ret.uniqueSpots = populatedCoords.size();
 
     // for each coord someone lives on, calculate what stops they might go to and time taken to do so
-    std::unordered_map<MeterCoord, std::vector<std::pair<StopId, double>>> walkableStops;
+    std::unordered_map<MeterCoord, std::vector<std::pair<StopIdx, double>>> walkableStops;
     walkableStops.reserve(populatedCoords.size());
 
     for (auto coord : populatedCoords)
@@ -167,37 +170,74 @@ E2EE::Stats E2EE::evaluatePerformanceAtPoint(MeterCoord origin, E2EE::Options op
             prox.stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
                 coord, opts.moveableDistance, opts.moveSpeed));
 
-    std::unordered_map<StopId, std::unordered_map<StopId, StopState>> dijkstraCache;
+    // all possible targets of each person, and the ones of everyone who can walk to a first stop, which is as far as
+    // the search from it has to go
+    std::vector<std::vector<std::pair<StopIdx, double>>> goalsOfPersons;
+    goalsOfPersons.reserve(filteredPersons.size());
+    std::unordered_map<StopIdx, SearchLimits> searchLimits;
+    for (const Person& person : filteredPersons) {
+        goalsOfPersons.push_back(
+            prox.stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
+                person.work_coord, opts.moveableDistance, opts.moveSpeed));
+        for (auto [firstStopId, firstStopTime] : walkableStops[person.home_coord]) {
+            std::vector<StopIdx>& targets = searchLimits[firstStopId].targets;
+            for (auto [endStopId, timeToGoal] : goalsOfPersons.back()) targets.push_back(endStopId);
+        }
+    }
+    for (auto& [firstStopId, limits] : searchLimits) {
+        std::sort(limits.targets.begin(), limits.targets.end());
+        limits.targets.erase(std::unique(limits.targets.begin(), limits.targets.end()), limits.targets.end());
+    }
+
+    std::unordered_map<StopIdx, std::vector<StopState>> dijkstraCache;
 
     RoutingOptions& routingOptions = opts.routingOptions;
-    for (auto person : filteredPersons) {
-        // all possible targets
-        std::vector<std::pair<StopId, double>> possibleVTGoals =
-            prox.stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
-                person.work_coord, opts.moveableDistance, opts.moveSpeed);
+
+    // The first stops are close to each other, and CSA searches from all of them at once, sharing its passes over the
+    // connections, each up to its targets. Only CSA is batched: dijkstra and raptor visit stops in an order of their
+    // own for every start, so with them every first stop is searched on its own in the loop below.
+    if (routingOptions.engine == RoutingEngine::CSA) {
+        std::vector<StopIdx> firstStops;
+        for (const auto& [firstStopId, limits] : searchLimits) {
+            if (!limits.targets.empty()) firstStops.push_back(firstStopId);
+        }
+        std::sort(firstStops.begin(), firstStops.end());
+        std::vector<SearchLimits> firstStopLimits;
+        firstStopLimits.reserve(firstStops.size());
+        for (StopIdx firstStopId : firstStops) firstStopLimits.push_back(searchLimits[firstStopId]);
+        auto results = timetable.connectionScan(std::span<const StopIdx>(firstStops), routingOptions,
+                                                std::span<const SearchLimits>(firstStopLimits), &ret.searchCounters);
+        for (size_t i = 0; i < firstStops.size(); i++) dijkstraCache.emplace(firstStops[i], std::move(results[i]));
+    }
+
+    for (size_t personIdx = 0; personIdx < filteredPersons.size(); personIdx++) {
+        const Person& person = filteredPersons[personIdx];
+        const std::vector<std::pair<StopIdx, double>>& possibleVTGoals = goalsOfPersons[personIdx];
 
         if (possibleVTGoals.empty()) {
             continue;
         }
 
         // Keep track of the fastest path found yet
-        PersonPath fastest{0, 0, 0, 0, 0, 60 * 60 * 24 * 5, 0};
+        PersonPath fastest{NO_STOP, 0, NO_STOP, 0, 0, 60 * 60 * 24 * 5, 0};
 
         // Loop over all possible first stops
         for (auto [firstStopId, firstStopTime] : walkableStops[person.home_coord]) {
             // If no dijkstra exists for that stop, cache it
             if (!dijkstraCache.contains(firstStopId)) {
-                dijkstraCache.insert_or_assign(firstStopId, timetable.dijkstra(firstStopId, routingOptions));
+                dijkstraCache.insert_or_assign(
+                    firstStopId,
+                    timetable.route(firstStopId, routingOptions, searchLimits[firstStopId], &ret.searchCounters));
             }
 
             // Get a hold on the dijkstra result for that first stop
-            std::unordered_map<StopId, StopState>& dijRes = dijkstraCache[firstStopId];
+            std::vector<StopState>& dijRes = dijkstraCache[firstStopId];
 
             // For each possible end stop...
             for (auto [endStopId, timeToGoal] : possibleVTGoals) {
                 // if second is reachable from firsts
-                if (dijRes.contains(endStopId)) {
-                    auto& timeToEndStop = dijRes.at(endStopId);
+                if (dijRes[endStopId].reached()) {
+                    auto& timeToEndStop = dijRes[endStopId];
 
                     auto firstStopTimeInt = static_cast<int32_t>(firstStopTime);
                     auto timeToGoalInt = static_cast<int32_t>(timeToGoal);
@@ -238,13 +278,13 @@ E2EE::Stats E2EE::evaluatePerformanceAtPoint(MeterCoord origin, E2EE::Options op
         }
 
         if (opts.statsToCollect & COLLECT_EXTRACTED_PATHS) {
-            if (fastest.firstStop != 0 && fastest.firstStop != fastest.secondStop) {  // so extract doesn't crash
+            if (fastest.firstStop != NO_STOP && fastest.firstStop != fastest.secondStop) {  // so extract doesn't crash
                 fastest.extractedPath = extractPath(timetable, fastest.secondStop, dijkstraCache.at(fastest.firstStop));
             }
         }
 
         if (opts.statsToCollect & COLLECT_AGGREGATED_SHAPES) {
-            if (fastest.firstStop != 0 && fastest.firstStop != fastest.secondStop) {
+            if (fastest.firstStop != NO_STOP && fastest.firstStop != fastest.secondStop) {
                 extractShape(timetable, fastest.secondStop, dijkstraCache.at(fastest.firstStop), ret.shapeSegments,
                              ret.transfers, ret.numberOfTransfers);
             }
@@ -279,28 +319,23 @@ std::ostream& operator<<(std::ostream& os, const E2EE::PersonPath& path) {
     std::to_string((n) / (60 * 60)) + ":" + ((((n) / 60) % 60) < 10 ? "0" : "") + (std::to_string(((n) / 60) % 60))
 
 std::string E2EE::PersonPath::toNiceString(const Timetable& tt) const {
-    if (this->firstStop == 0) {
+    if (this->firstStop == NO_STOP) {
         return "Invalid path, firstStop doesn't exist";
     }
-    if (this->secondStop == 0) {
+    if (this->secondStop == NO_STOP) {
         return "Invalid path, secondStop doesn't exist";
     }
 
     std::stringstream s;
-    s << "Walk " << this->timeToFirstStop << " s and take transport from " << tt.stops.at(this->firstStop).name;
-    s << " to arrive at " << tt.stops.at(this->secondStop).name << " after ";
+    s << "Walk " << this->timeToFirstStop << " s and take transport from ";
+    s << tt.strings[tt.stops.at(this->firstStop).name];
+    s << " to arrive at " << tt.strings[tt.stops.at(this->secondStop).name] << " after ";
     s << prettyTravelTime(this->timeToSecondStop) << ". Walk for " << this->timeToGoal << "s to arrive ";
     s << "at the goal at " << TIME(timestampAtGoal) << ".";
 
     if (!this->extractedPath.empty()) {
         s << " Path taken: Home";
-        for (auto stopID : this->extractedPath) {
-            if (stopID == WALK) {
-                s << "->WALK";
-            } else {
-                s << "->" << tt.stops.at(stopID).name;
-            }
-        }
+        for (auto stopID : this->extractedPath) s << "->" << tt.strings[tt.stops.at(stopID).name];
     }
     return s.str();
 }
@@ -321,7 +356,7 @@ void E2EE::test() {
      */
 
     // mossen Mossen,57.681522,11.984383,9021014004830000
-    StopId target = 9021014004830000;
+    StopIdx target = timetable.stopIndex.at(9021014004830000);
     double latitude = 57.681522;
     double longitude = 11.984383;
     auto originCoord = DMSCoord(latitude, longitude).toMeter();
@@ -372,10 +407,10 @@ std::string E2EE::Stats::prettyString() {
     std::stringstream s;
     s << "STATS FOR EVALUATION OF VÄSTTRAFIK PERFORMANCE:\n";
     std::string is;
-    StopId isid = 0;
-    if (opts != nullptr && (isid = opts->interestingStop) != 0) {
-        is =
-            tt != nullptr && tt->stops.contains(isid) ? (tt->stops.at(isid).name) : "[ID:" + std::to_string(isid) + "]";
+    StopIdx isid = NO_STOP;
+    if (opts != nullptr && (isid = opts->interestingStop) != NO_STOP) {
+        is = tt != nullptr && isid < tt->stops.size() ? std::string(tt->strings[tt->stops[isid].name])
+                                                      : "[IDX:" + std::to_string(isid) + "]";
         s << "Interesting stop: " + is + "\n";
         s << "Search range: " << opts->searchRange << "m\n";
     } else {
@@ -393,7 +428,7 @@ std::string E2EE::Stats::prettyString() {
     if (opts != nullptr) s << " by walking at most " << opts->moveableDistance << "m";
     s << "\n";
 
-    if (isid != 0)
+    if (isid != NO_STOP)
         s << " * " << PWF(hasThisAsOptimal, personsCanGoWithBus) << " had " << is << " as the optimal first stop\n";
     s << "\n";
     s << allPaths.size() << " paths stored";
@@ -446,16 +481,18 @@ std::string E2EE::Stats::prettyString() {
     if (!optimalFirstStop.empty()) {
         s << "\nOut of the persons living in the range, this is the stops they walk to:" << std::endl;
         for (auto [stopid, noppl] : optimalFirstStop) {
-            auto name = tt != nullptr && tt->stops.contains(stopid) ? (tt->stops.at(stopid).name)
-                                                                    : "[ID:" + std::to_string(stopid) + "]";
-            if (stopid == routing::WALK) {
-                s << "WALK: ";
-            } else {
-                s << name << ": ";
-            }
+            auto name = tt != nullptr && stopid < tt->stops.size() ? std::string(tt->strings[tt->stops[stopid].name])
+                                                                   : "[IDX:" + std::to_string(stopid) + "]";
+            s << name << ": ";
             s << PWF(noppl, personsCanGoWithBus) << std::endl;
         }
     }
 
+    if (searchCounters.searches != 0) {
+        s << "\n" << searchCounters.searches << " searches from first stops settled " << searchCounters.settledStops
+          << " stops, " << searchCounters.stoppedEarly << " of them stopped once the possible end stops were settled, "
+          << "leaving " << searchCounters.prunedStops << " stops they had reached unsettled\n";
+    }
+
     return s.str();
 }
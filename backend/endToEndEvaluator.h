@@ -12,15 +12,16 @@ class E2EE {
    public:
     struct ShapeSegment;
 
+    // Stops are referred to by their index in the timetable, see routing::StopIdx
     struct PersonPath {
-        StopId firstStop;
+        routing::StopIdx firstStop;
         int32_t timeToFirstStop;  // time taken, home->first stop
-        StopId secondStop;
+        routing::StopIdx secondStop;
         int32_t timeToSecondStop;  // time taken, first->second stop
         int32_t timeToGoal;        // time taken, second->goal
         int32_t timeAtGoal;        // total time taken, home->goal
         int32_t timestampAtGoal;   // timestamp at goal
-        std::vector<StopId> extractedPath;
+        std::vector<routing::StopIdx> extractedPath;
         int32_t initialWaitTime;
 
         friend std::ostream& operator<<(std::ostream& os, const PersonPath& path);
@@ -28,20 +29,20 @@ class E2EE {
     };
 
     struct ShapeSegment {
-        StopId startStop{};
-        StopId endStop{};
-        TripId tripId{};
+        routing::StopIdx startStop{};
+        routing::StopIdx endStop{};
+        routing::TripIdx trip{};
         int32_t startIdx{};
         int32_t endIdx{};
         int32_t stopSequence{};
         int32_t passengerCount = 1;
 
         ShapeSegment() = default;
-        ShapeSegment(StopId start_stop, StopId end_stop, TripId trip_id, int32_t start_idx, int32_t end_idx,
-                     int32_t stop_sequence)
+        ShapeSegment(routing::StopIdx start_stop, routing::StopIdx end_stop, routing::TripIdx trip, int32_t start_idx,
+                     int32_t end_idx, int32_t stop_sequence)
             : startStop(start_stop),
               endStop(end_stop),
-              tripId(trip_id),
+              trip(trip),
               startIdx(start_idx),
               stopSequence(stop_sequence),
               endIdx(end_idx) {}
@@ -58,8 +59,8 @@ class E2EE {
         std::map<uint64_t, int, std::less<>> distNumberOfStartStops;
         std::map<uint64_t, int, std::less<>> distNumberOfEndStops;
         uint64_t hasThisAsOptimal = 0;
-        uint64_t interestingStop = 0;
-        std::unordered_map<StopId, int> optimalFirstStop;
+        routing::StopIdx interestingStop = routing::NO_STOP;
+        std::unordered_map<routing::StopIdx, int> optimalFirstStop;
 
         std::vector<PersonPath> allPaths;
 
@@ -67,9 +68,12 @@ class E2EE {
         E2EE::Options* opts = nullptr;
 
         std::unordered_map<SegmentId, ShapeSegment> shapeSegments;
-        std::unordered_map<StopId, int32_t> transfers;
+        std::unordered_map<routing::StopIdx, int32_t> transfers;
         uint64_t numberOfTransfers = 0;
 
+        // How much the searches from the first stops were cut short by only searching for the possible end stops
+        routing::SearchCounters searchCounters;
+
         Stats() = default;
         friend std::ostream& operator<<(std::ostream& os, const Stats& stats);
         std::string prettyString();
@@ -78,7 +82,7 @@ class E2EE {
     using StatConfig = uint32_t;
 
     struct Options {
-        StopId interestingStop;
+        routing::StopIdx interestingStop;
         double moveSpeed;  // meter per seconds, very important!!!
         int searchRange;
         int moveableDistance;
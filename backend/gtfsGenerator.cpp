@@ -0,0 +1,404 @@
+// Writes a synthetic GTFS feed with the same id scheme and column layout as the Västtrafik feed, so that the loaders,
+// the router and the server can be benchmarked at any network size without the real data in data/raw.
+//
+// Usage: gtfsGenerator <output dir> [--scale k] [--stops n] [--routes n] [--trips n] [--days n] [--transfers p]
+//                      [--start YYYYMMDD] [--seed n]
+//
+// The defaults are roughly the size of the Västtrafik network, and --scale multiplies the number of stops and routes.
+// The same arguments always give byte for byte the same feed.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtfsTypes.h"
+#include "synthetic.h"
+
+namespace {
+using synthetic::CsvWriter;
+using synthetic::Random;
+
+struct Options {
+    std::filesystem::path output;
+    int32_t stops = 13000;
+    int32_t routes = 900;
+    int32_t tripsPerRoute = 120;
+    int32_t days = 28;
+    double transferDensity = 0.1;
+    int32_t startDate = 20221114;
+    uint64_t seed = 1;
+};
+
+// Västtrafik ids: stop areas are 9021014XXXXXX000 where XXXXXX is the external stop number, and their stop points
+// (platforms) are the area id + 10^12 + the platform number. This is what stopAreaFromStopPoint and isStopPoint in
+// routing.cpp rely on.
+StopId stopAreaId(int32_t index) { return 9021014000000000 + static_cast<StopId>(index + 1) * 1000; }
+StopId stopPointId(int32_t index, int32_t platform) { return stopAreaId(index) + 1000000000000 + platform; }
+RouteId routeId(int32_t index) { return 9011014500000000 + static_cast<RouteId>(index + 1) * 100000; }
+ShapeId shapeId(int32_t route, int32_t direction) {
+    return 1014000000000000 + static_cast<ShapeId>(route + 1) * 100000 + (direction + 1) * 10000;
+}
+TripId tripId(uint64_t index) { return 55700000000000001 + index; }
+constexpr AgencyId agencyId = 279;
+
+// Distance between stops on the grid in meters. Stops are moved up to a third of this from their grid point.
+constexpr double gridSpacing = 500;
+constexpr double originLat = 57.70;
+constexpr double originLon = 11.97;
+constexpr double metersPerDegreeLat = 111320;
+
+struct Stop {
+    std::string name;
+    double lat, lon;
+    int32_t platforms;
+};
+
+struct Pattern {
+    int32_t route;
+    int32_t direction;
+    std::vector<int32_t> stops;
+    std::vector<int32_t> runTimes;    // Seconds from the first stop
+    std::vector<double> distances;    // Meters from the first stop
+};
+
+struct GeneratedTrip {
+    TripId id;
+    int32_t pattern;
+    ServiceId service;
+    int32_t start;
+};
+
+// Services: 1 runs every day, 2 on weekdays, 3 on weekends
+constexpr ServiceId everyDay = 1, weekdays = 2, weekends = 3;
+
+double distance(const Stop& a, const Stop& b) {
+    double dLat = (a.lat - b.lat) * metersPerDegreeLat;
+    double dLon = (a.lon - b.lon) * metersPerDegreeLat * std::cos(originLat * std::numbers::pi / 180);
+    return std::sqrt(dLat * dLat + dLon * dLon);
+}
+
+std::string stopName(Random& random) {
+    static const char* const prefixes[] = {"Berg", "Dal",  "Lund", "Sjö",  "Ek",   "Björk", "Sten", "Kyrk", "Hag",
+                                           "Vik",  "Ström", "Mos", "Gran", "Ängs", "Lin",   "Ros",  "Fisk", "Kvarn"};
+    static const char* const suffixes[] = {"gatan", "torget", "platsen", "vägen",   "skolan", "backen",
+                                           "hamnen", "torp",  "by",      "centrum", "parken", "station"};
+    std::string name = prefixes[random.below(std::size(prefixes))];
+    name += suffixes[random.below(std::size(suffixes))];
+    return name;
+}
+
+std::vector<Stop> generateStops(const Options& options, int32_t width, Random& random) {
+    double latStep = gridSpacing / metersPerDegreeLat;
+    double lonStep = latStep / std::cos(originLat * std::numbers::pi / 180);
+
+    std::vector<Stop> stops(options.stops);
+    for (int32_t i = 0; i < options.stops; i++) {
+        double x = i % width + (random.real() - 0.5) * 2 / 3;
+        double y = i / width + (random.real() - 0.5) * 2 / 3;
+        stops[i] = {stopName(random), originLat + y * latStep, originLon + x * lonStep, random.between(1, 3)};
+    }
+    return stops;
+}
+
+// Walks from a random stop along the grid, mostly straight ahead, without visiting a stop twice
+std::vector<int32_t> generatePath(const Options& options, int32_t width, Random& random) {
+    const int32_t dx[] = {1, 0, -1, 0}, dy[] = {0, 1, 0, -1};
+    int32_t height = (options.stops + width - 1) / width;
+    int32_t length = random.between(8, 40);
+
+    std::vector<int32_t> path = {static_cast<int32_t>(random.below(options.stops))};
+    int32_t heading = static_cast<int32_t>(random.below(4));
+
+    while (static_cast<int32_t>(path.size()) < length) {
+        if (random.chance(0.2)) heading = (heading + (random.chance(0.5) ? 1 : 3)) % 4;
+
+        bool moved = false;
+        for (int32_t turn : {0, 1, 3}) {
+            int32_t h = (heading + turn) % 4;
+            int32_t x = path.back() % width + dx[h], y = path.back() / width + dy[h];
+            if (x < 0 || x >= width || y < 0 || y >= height) continue;
+            int32_t next = y * width + x;
+            if (next >= options.stops || std::find(path.begin(), path.end(), next) != path.end()) continue;
+
+            path.push_back(next);
+            heading = h;
+            moved = true;
+            break;
+        }
+        if (!moved) break;
+    }
+    return path;
+}
+
+Pattern makePattern(int32_t route, int32_t direction, std::vector<int32_t> path, const std::vector<Stop>& stops,
+                    double speed, Random& random) {
+    Pattern pattern{route, direction, std::move(path), {0}, {0}};
+    for (size_t i = 1; i < pattern.stops.size(); i++) {
+        double meters = distance(stops[pattern.stops[i - 1]], stops[pattern.stops[i]]);
+        // Whole minutes between stops like in the real timetable, with some slack for traffic and dwelling
+        auto seconds = static_cast<int32_t>(std::ceil(meters / speed * (1 + random.real() * 0.3) / 60)) * 60;
+        pattern.runTimes.push_back(pattern.runTimes.back() + std::max(seconds, 60));
+        pattern.distances.push_back(pattern.distances.back() + meters);
+    }
+    return pattern;
+}
+
+std::chrono::sys_days toDays(int32_t date) {
+    return std::chrono::year_month_day{std::chrono::year{date / 10000}, std::chrono::month(date / 100 % 100),
+                                       std::chrono::day(date % 100)};
+}
+
+int32_t fromDays(std::chrono::sys_days days) {
+    std::chrono::year_month_day ymd{days};
+    return static_cast<int32_t>(ymd.year()) * 10000 + static_cast<int32_t>(static_cast<unsigned>(ymd.month())) * 100 +
+           static_cast<int32_t>(static_cast<unsigned>(ymd.day()));
+}
+
+void writeStatic(const Options& options) {
+    CsvWriter agency(options.output / "agency.txt",
+                     "agency_id,agency_name,agency_url,agency_timezone,agency_lang,agency_fare_url");
+    agency << agencyId << "Syntetisk Trafik" << "https://example.com" << "Europe/Stockholm" << "sv";
+    agency.empty().endRow();
+
+    CsvWriter attributions(options.output / "attributions.txt", "trip_id,organization_name,is_operator");
+
+    CsvWriter feedInfo(options.output / "feed_info.txt",
+                       "feed_id,feed_publisher_name,feed_publisher_url,feed_lang,feed_version");
+    std::string version = "synthetic-" + std::to_string(options.startDate) + "-" + std::to_string(options.seed);
+    feedInfo << "SYNTH" << "Syntetisk Trafik" << "https://example.com" << "sv" << version;
+    feedInfo.endRow();
+}
+
+void writeCalendar(const Options& options) {
+    CsvWriter calendar(options.output / "calendar.txt",
+                       "service_id,monday,tuesday,wednesday,thursday,friday,saturday,sunday,start_date,end_date");
+    CsvWriter calendarDates(options.output / "calendar_dates.txt", "service_id,date,exception_type");
+
+    auto start = toDays(options.startDate);
+    int32_t end = fromDays(start + std::chrono::days(options.days - 1));
+    for (ServiceId service : {everyDay, weekdays, weekends}) {
+        calendar << service;
+        for (int32_t day = 0; day < 7; day++) {
+            bool runs = service == everyDay || (service == weekdays) == (day < 5);
+            calendar << static_cast<int32_t>(runs);
+        }
+        calendar << options.startDate << end;
+        calendar.endRow();
+    }
+
+    // The feed lists every date explicitly as well, like the Västtrafik feed does
+    for (int32_t i = 0; i < options.days; i++) {
+        auto date = start + std::chrono::days(i);
+        bool weekend = std::chrono::weekday{date}.iso_encoding() >= 6;
+        for (ServiceId service : {everyDay, weekend ? weekends : weekdays}) {
+            calendarDates << service << fromDays(date) << 1;
+            calendarDates.endRow();
+        }
+    }
+}
+
+void writeStops(const Options& options, const std::vector<Stop>& stops) {
+    CsvWriter out(options.output / "stops.txt",
+                  "stop_id,stop_name,stop_lat,stop_lon,location_type,parent_station,platform_code");
+    for (int32_t i = 0; i < options.stops; i++) {
+        const Stop& stop = stops[i];
+        out << stopAreaId(i) << stop.name;
+        out.fixed(stop.lat, 6).fixed(stop.lon, 6) << 1;
+        out.empty().empty().endRow();
+
+        for (int32_t platform = 1; platform <= stop.platforms; platform++) {
+            // Platforms are a few meters apart
+            double offset = (platform - 1) * 0.0002;
+            out << stopPointId(i, platform) << stop.name;
+            out.fixed(stop.lat + offset, 6).fixed(stop.lon, 6) << 0 << stopAreaId(i);
+            out << std::string(1, static_cast<char>('A' + platform - 1));
+            out.endRow();
+        }
+    }
+}
+
+int32_t platformFor(const Stop& stop, int32_t direction) { return direction % stop.platforms + 1; }
+
+void writeRoutesAndShapes(const Options& options, const std::vector<Stop>& stops,
+                          const std::vector<Pattern>& patterns) {
+    CsvWriter routes(options.output / "routes.txt",
+                     "route_id,agency_id,route_short_name,route_long_name,route_type,route_desc");
+    for (int32_t i = 0; i < options.routes; i++) {
+        // Every tenth route is a tram, the rest are buses
+        routes << routeId(i) << agencyId << std::to_string(i + 1);
+        routes.empty() << (i % 10 == 0 ? 900 : 700);
+        routes.empty().endRow();
+    }
+
+    CsvWriter shapes(options.output / "shapes.txt",
+                     "shape_id,shape_pt_lat,shape_pt_lon,shape_pt_sequence,shape_dist_traveled");
+    for (const Pattern& pattern : patterns) {
+        for (size_t i = 0; i < pattern.stops.size(); i++) {
+            const Stop& stop = stops[pattern.stops[i]];
+            shapes << shapeId(pattern.route, pattern.direction);
+            shapes.fixed(stop.lat, 6).fixed(stop.lon, 6) << static_cast<int32_t>(i + 1);
+            shapes.fixed(pattern.distances[i], 2).endRow();
+        }
+    }
+}
+
+void writeTrips(const Options& options, const std::vector<Stop>& stops, const std::vector<Pattern>& patterns,
+                const std::vector<GeneratedTrip>& trips) {
+    CsvWriter out(options.output / "trips.txt", "route_id,service_id,trip_id,trip_headsign,direction_id,shape_id");
+    CsvWriter stopTimes(options.output / "stop_times.txt",
+                        "trip_id,arrival_time,departure_time,stop_id,stop_sequence,stop_headsign,pickup_type,"
+                        "drop_off_type,shape_dist_traveled,timepoint");
+
+    for (const GeneratedTrip& trip : trips) {
+        const Pattern& pattern = patterns[trip.pattern];
+        const std::string& headsign = stops[pattern.stops.back()].name;
+        out << routeId(pattern.route) << trip.service << trip.id << headsign << pattern.direction;
+        out << shapeId(pattern.route, pattern.direction);
+        out.endRow();
+
+        auto n = static_cast<int32_t>(pattern.stops.size());
+        for (int32_t i = 0; i < n; i++) {
+            const Stop& stop = stops[pattern.stops[i]];
+            int32_t time = trip.start + pattern.runTimes[i];
+            stopTimes << trip.id;
+            stopTimes.time(time).time(time) << stopPointId(pattern.stops[i], platformFor(stop, pattern.direction));
+            // No boarding at the last stop and no alighting at the first
+            stopTimes << i + 1 << headsign << static_cast<int32_t>(i == n - 1) << static_cast<int32_t>(i == 0);
+            stopTimes.fixed(pattern.distances[i], 2) << 1;
+            stopTimes.endRow();
+        }
+    }
+}
+
+void writeTransfers(const Options& options, int32_t width, const std::vector<Stop>& stops,
+                    const std::vector<Pattern>& patterns, const std::vector<GeneratedTrip>& trips, Random& random) {
+    CsvWriter out(options.output / "transfers.txt",
+                  "from_stop_id,to_stop_id,transfer_type,min_transfer_time,from_trip_id,to_trip_id");
+
+    for (int32_t i = 0; i < options.stops; i++) {
+        // A longer change margin within a stop area
+        if (random.chance(options.transferDensity)) {
+            out << stopAreaId(i) << stopAreaId(i) << 2 << random.between(2, 5) * 60;
+            out.empty().empty().endRow();
+        }
+
+        // Walking to the neighbouring stop areas to the east and north
+        for (int32_t next : {i % width + 1 < width ? i + 1 : -1, i + width}) {
+            if (next < 0 || next >= options.stops || !random.chance(options.transferDensity)) continue;
+            auto walk = static_cast<int32_t>(distance(stops[i], stops[next]) / 1.2);
+            for (auto [from, to] : {std::pair{i, next}, std::pair{next, i}}) {
+                out << stopPointId(from, 1) << stopPointId(to, 1) << 2 << walk;
+                out.empty().empty().endRow();
+            }
+        }
+    }
+
+    // Stay seated transfers where a trip turns around at the end of the line and continues in the other direction
+    std::vector<std::vector<const GeneratedTrip*>> byPattern(patterns.size());
+    for (const GeneratedTrip& trip : trips) byPattern[trip.pattern].push_back(&trip);
+
+    for (size_t p = 0; p + 1 < patterns.size(); p += 2) {
+        const Pattern& outbound = patterns[p];
+        int32_t end = outbound.stops.back();
+        for (const GeneratedTrip* from : byPattern[p]) {
+            if (!random.chance(options.transferDensity)) continue;
+            int32_t arrival = from->start + outbound.runTimes.back();
+            for (const GeneratedTrip* to : byPattern[p + 1]) {
+                if (to->service != from->service || to->start < arrival) continue;
+                // Both directions stop at the same area, so the transfer is between their platforms there
+                StopId fromStop = stopPointId(end, platformFor(stops[end], 0));
+                StopId toStop = stopPointId(end, platformFor(stops[end], 1));
+                out << fromStop << toStop << 1;
+                out.empty() << from->id << to->id;
+                out.endRow();
+                break;
+            }
+        }
+    }
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    if (argc < 2) return false;
+    options.output = argv[1];
+
+    double scale = 1;
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 >= argc) return false;
+        std::string_view key = argv[i];
+        const char* value = argv[i + 1];
+        if (key == "--scale") scale = std::atof(value);
+        else if (key == "--stops") options.stops = std::atoi(value);
+        else if (key == "--routes") options.routes = std::atoi(value);
+        else if (key == "--trips") options.tripsPerRoute = std::atoi(value);
+        else if (key == "--days") options.days = std::atoi(value);
+        else if (key == "--transfers") options.transferDensity = std::atof(value);
+        else if (key == "--start") options.startDate = std::atoi(value);
+        else if (key == "--seed") options.seed = std::strtoull(value, nullptr, 10);
+        else return false;
+    }
+
+    options.stops = static_cast<int32_t>(options.stops * scale);
+    options.routes = static_cast<int32_t>(options.routes * scale);
+    // The stop number has six digits in the id scheme
+    return options.stops >= 2 && options.stops <= 999999 && options.routes >= 1 && options.tripsPerRoute >= 2 &&
+           options.days >= 1;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <output dir> [--scale k] [--stops n] [--routes n] [--trips n] [--days n] [--transfers p]"
+                     " [--start YYYYMMDD] [--seed n]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::create_directories(options.output);
+    Random random(options.seed);
+
+    auto width = static_cast<int32_t>(std::ceil(std::sqrt(options.stops)));
+    std::vector<Stop> stops = generateStops(options, width, random);
+
+    // Every route runs the same path in both directions, direction 0 at even and direction 1 at odd pattern indices
+    std::vector<Pattern> patterns;
+    for (int32_t route = 0; route < options.routes; route++) {
+        std::vector<int32_t> path = generatePath(options, width, random);
+        double speed = route % 10 == 0 ? 20 / 3.6 : 30 / 3.6;
+        patterns.push_back(makePattern(route, 0, path, stops, speed, random));
+        std::reverse(path.begin(), path.end());
+        patterns.push_back(makePattern(route, 1, std::move(path), stops, speed, random));
+    }
+
+    // Departures from 05:00 until after midnight with an even headway per route, split over the services
+    std::vector<GeneratedTrip> trips;
+    uint64_t tripCount = 0;
+    for (size_t p = 0; p < patterns.size(); p++) {
+        int32_t perDirection = options.tripsPerRoute / 2;
+        int32_t headway = std::max(60, (20 * 3600 / perDirection) / 60 * 60);
+        int32_t offset = random.between(0, headway / 60) * 60;
+        for (int32_t i = 0; i < perDirection; i++) {
+            double kind = random.real();
+            ServiceId service = kind < 0.6 ? weekdays : kind < 0.9 ? everyDay : weekends;
+            trips.push_back({tripId(tripCount++), static_cast<int32_t>(p), service, 5 * 3600 + offset + i * headway});
+        }
+    }
+
+    std::cout << "Writing " << options.stops << " stops, " << options.routes << " routes and " << trips.size()
+              << " trips to " << options.output << std::endl;
+
+    writeStatic(options);
+    writeCalendar(options);
+    writeStops(options, stops);
+    writeRoutesAndShapes(options, stops, patterns);
+    writeTrips(options, stops, patterns, trips);
+    writeTransfers(options, width, stops, patterns, trips, random);
+    return 0;
+}
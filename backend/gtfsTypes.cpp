@@ -1,6 +1,7 @@
 #include "gtfsTypes.h"
 
 #include <functional>
+#include <sstream>
 
 #include "csvLoader.h"
 
@@ -8,51 +9,83 @@ namespace gtfs {
 
 std::vector<Agency> Agency::load(const std::string& gtfsPath) {
     return csvLoader::load<Agency, AgencyId, std::string, std::string, std::string, std::string, std::string>(
-        gtfsPath + "/agency.txt");
+        gtfsPath + "/agency.txt",
+        {"agency_id", "agency_name", "agency_url", "agency_timezone", "agency_lang", "agency_fare_url"});
 }
 
 std::vector<Attribution> Attribution::load(const std::string& gtfsPath) {
-    return csvLoader::load<Attribution, TripId, std::string, bool>(gtfsPath + "/attributions.txt");
+    return csvLoader::load<Attribution, TripId, std::string, bool>(gtfsPath + "/attributions.txt",
+                                                                  {"trip_id", "organization_name", "is_operator"});
 }
 
 std::vector<Calendar> Calendar::load(const std::string& gtfsPath) {
-    return csvLoader::load<Calendar, ServiceId, bool, bool, bool, bool, bool, bool, bool, Date, Date>(gtfsPath +
-                                                                                                      "/calendar.txt");
+    return csvLoader::load<Calendar, ServiceId, bool, bool, bool, bool, bool, bool, bool, Date, Date>(
+        gtfsPath + "/calendar.txt", {"service_id", "monday", "tuesday", "wednesday", "thursday", "friday", "saturday",
+                                     "sunday", "start_date", "end_date"});
 }
 
 std::vector<CalendarDate> CalendarDate::load(const std::string& gtfsPath) {
-    return csvLoader::load<CalendarDate, ServiceId, Date, bool>(gtfsPath + "/calendar_dates.txt");
+    return csvLoader::parallelLoad<CalendarDate, ServiceId, Date, int32_t>(gtfsPath + "/calendar_dates.txt",
+                                                                        {"service_id", "date", "exception_type"});
 }
 
 std::vector<FeedInfo> FeedInfo::load(const std::string& gtfsPath) {
-    return csvLoader::load<FeedInfo, std::string, std::string, std::string, std::string, std::string>(gtfsPath +
-                                                                                                      "/feed_info.txt");
+    return csvLoader::load<FeedInfo, std::string, std::string, std::string, std::string, std::string>(
+        gtfsPath + "/feed_info.txt",
+        {"feed_id", "feed_publisher_name", "feed_publisher_url", "feed_lang", "feed_version"});
 }
 
 std::vector<Route> Route::load(const std::string& gtfsPath) {
-    return csvLoader::load<Route, RouteId, AgencyId, std::string, std::string, int, std::string>(gtfsPath +
-                                                                                                 "/routes.txt");
+    return csvLoader::load<Route, RouteId, AgencyId, std::string, std::string, int, std::string>(
+        gtfsPath + "/routes.txt",
+        {"route_id", "agency_id", "route_short_name", "route_long_name", "route_type", "route_desc"});
 }
 
+static const csvLoader::Columns<5> shapeColumns = {"shape_id", "shape_pt_lat", "shape_pt_lon", "shape_pt_sequence",
+                                                   "shape_dist_traveled"};
+
 std::vector<Shape> Shape::load(const std::string& gtfsPath) {
-    return csvLoader::load<Shape, ShapeId, double, double, int, double>(gtfsPath + "/shapes.txt");
+    return csvLoader::parallelLoad<Shape, ShapeId, double, double, int, double>(gtfsPath + "/shapes.txt",
+                                                                                shapeColumns);
+}
+
+bool Shape::forEach(const std::string& gtfsPath, const std::function<void(Shape&&)>& callback) {
+    return csvLoader::forEach<ShapeId, double, double, int, double>(
+        gtfsPath + "/shapes.txt", shapeColumns,
+        [&callback](auto&&... vals) { callback(Shape(std::move(vals)...)); });
 }
 
+static const csvLoader::Columns<10> stopTimeColumns = {
+    "trip_id",       "arrival_time", "departure_time", "stop_id",             "stop_sequence",
+    "stop_headsign", "pickup_type",  "drop_off_type",  "shape_dist_traveled", "timepoint"};
+
 std::vector<StopTime> StopTime::load(const std::string& gtfsPath) {
-    return csvLoader::load<StopTime, TripId, Time, Time, StopId, int, std::string, int, int, double, bool>(
-        gtfsPath + "/stop_times.txt");
+    return csvLoader::parallelLoad<StopTime, TripId, Time, Time, StopId, int, std::string, int, int, double, bool>(
+        gtfsPath + "/stop_times.txt", stopTimeColumns);
+}
+
+bool StopTime::forEach(const std::string& gtfsPath, const std::function<void(StopTime&&)>& callback) {
+    return csvLoader::forEach<TripId, Time, Time, StopId, int, std::string, int, int, double, bool>(
+        gtfsPath + "/stop_times.txt", stopTimeColumns,
+        [&callback](auto&&... vals) { callback(StopTime(std::move(vals)...)); });
 }
 
 std::vector<Stop> Stop::load(const std::string& gtfsPath) {
-    return csvLoader::load<Stop, StopId, std::string, float, float, int32_t, Ignore, Ignore>(gtfsPath + "/stops.txt");
+    return csvLoader::load<Stop, StopId, std::string, float, float, int32_t, Ignore, Ignore>(
+        gtfsPath + "/stops.txt",
+        {"stop_id", "stop_name", "stop_lat", "stop_lon", "location_type", "parent_station", "platform_code"});
 }
 
 std::vector<Transfer> Transfer::load(const std::string& gtfsPath) {
-    return csvLoader::load<Transfer, StopId, StopId, int, int, TripId, TripId>(gtfsPath + "/transfers.txt");
+    return csvLoader::load<Transfer, StopId, StopId, int, int, TripId, TripId>(
+        gtfsPath + "/transfers.txt",
+        {"from_stop_id", "to_stop_id", "transfer_type", "min_transfer_time", "from_trip_id", "to_trip_id"});
 }
 
 std::vector<Trip> Trip::load(const std::string& gtfsPath) {
-    return csvLoader::load<Trip, uint64_t, ServiceId, TripId, std::string, int32_t, uint64_t>(gtfsPath + "/trips.txt");
+    return csvLoader::parallelLoad<Trip, uint64_t, ServiceId, TripId, std::string, int32_t, uint64_t>(
+        gtfsPath + "/trips.txt",
+        {"route_id", "service_id", "trip_id", "trip_headsign", "direction_id", "shape_id"});
 }
 
 template <typename T>
@@ -69,6 +102,162 @@ void testLoad(std::function<std::vector<T>(const std::string&)> loader, const st
     std::cout << std::endl;
 }
 
+// The field parsers as they were before they moved to std::from_chars and fixed layout time and date parsing. Only
+// kept as a baseline for benchmarkParsers.
+namespace legacy {
+static std::vector<std::string> split(const std::string& str) {
+    int i = 0;
+    int ptr = 0;
+    char c;
+    bool instr = false;
+    std::vector<std::string> acc;
+    while (true) {
+        while ((c = str[ptr++]) != ',' && c != 0 && c != '"')
+            ;
+        if (c == '"') {
+            instr = !instr;
+            continue;
+        }
+        if (instr) {
+            continue;
+        }
+        acc.push_back(str.substr(i, ptr - i - 1));
+        i = ptr;
+        if (c == 0) break;
+    }
+    return acc;
+}
+
+static uint64_t parseu64(const std::string& str) {
+    if (str.empty() || str == "\r") return 0;
+    return std::stoull(str);
+}
+
+static int parseInt(const std::string& str) {
+    if (str.empty() || str == "\r") return 0;
+    return std::stoi(str);
+}
+
+static double parseDouble(const std::string& str) {
+    if (str.empty() || str == "\r") return 0;
+    return std::stod(str);
+}
+
+static Time parseTime(const std::string& str) {
+    std::stringstream ss(str);
+    int32_t h, m, s;
+    char c;
+    ss >> h >> c >> m >> c >> s;
+    return Time{h * 60 * 60 + m * 60 + s};
+}
+
+static StopTime parseStopTime(const std::string& line) {
+    auto vals = split(line);
+    return {parseu64(vals[0]), parseTime(vals[1]), parseTime(vals[2]), parseu64(vals[3]), parseInt(vals[4]),
+            vals[5],           parseInt(vals[6]),  parseInt(vals[7]),  parseDouble(vals[8]), !parseInt(vals[9])};
+}
+}  // namespace legacy
+
+// Parses every row of stop_times.txt with the legacy parsers and with the current ones, and prints rows per second
+// for both. Both run from memory on the same records, so only splitting and field parsing is measured.
+void benchmarkParsers(const std::string& gtfsPath) {
+    std::cout << "[TEST] Benchmarking field parsers on stop_times.txt" << std::endl;
+    csvLoader::MappedFile file(gtfsPath + "/stop_times.txt");
+    if (!file.isOpen()) {
+        std::cout << "[TEST] Could not open stop_times.txt, skipping" << std::endl;
+        return;
+    }
+
+    std::vector<std::string_view> records;
+    csvLoader::forEachRecord(file.view(), [&records](std::string_view line) {
+        records.push_back(line);
+        return true;
+    });
+    if (records.size() < 2) return;
+    size_t rows = records.size() - 1;
+
+    int64_t checksumLegacy = 0;
+    auto startLegacy = std::chrono::high_resolution_clock::now();
+    for (size_t i = 1; i < records.size(); i++) {
+        StopTime st = legacy::parseStopTime(std::string(records[i]));
+        checksumLegacy += st.departureTime.timestamp + st.stopSequence + static_cast<int64_t>(st.shapeDistTravelled);
+    }
+    auto stopLegacy = std::chrono::high_resolution_clock::now();
+
+    int64_t checksum = 0;
+    std::vector<std::string_view> vals;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 1; i < records.size(); i++) {
+        csvLoader::split(records[i], vals);
+        StopTime st = {csvLoader::parse<TripId>(vals[0]), csvLoader::parse<Time>(vals[1]),
+                       csvLoader::parse<Time>(vals[2]),   csvLoader::parse<StopId>(vals[3]),
+                       csvLoader::parse<int>(vals[4]),    csvLoader::parse<std::string>(vals[5]),
+                       csvLoader::parse<int>(vals[6]),    csvLoader::parse<int>(vals[7]),
+                       csvLoader::parse<double>(vals[8]), csvLoader::parse<bool>(vals[9])};
+        checksum += st.departureTime.timestamp + st.stopSequence + static_cast<int64_t>(st.shapeDistTravelled);
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    auto legacyUs = duration_cast<std::chrono::microseconds>(stopLegacy - startLegacy).count();
+    auto currentUs = duration_cast<std::chrono::microseconds>(stop - start).count();
+    auto rowsPerSecond = [rows](int64_t us) {
+        return static_cast<uint64_t>(static_cast<double>(rows) * 1e6 / static_cast<double>(std::max<int64_t>(us, 1)));
+    };
+    double improvement = static_cast<double>(legacyUs) / static_cast<double>(std::max<int64_t>(currentUs, 1));
+
+    std::cout << "[TEST] [" << rows << " rows] [LEGACY=" << rowsPerSecond(legacyUs) << " rows/s] [CURRENT="
+              << rowsPerSecond(currentUs) << " rows/s] [" << improvement << "x speed] "
+              << (checksum == checksumLegacy ? "[SAME RESULT]" : "[RESULTS DIFFER]") << std::endl;
+}
+
+// Splits every line of stop_times.txt with the scalar splitter and with the vectorized one, checks that they give the
+// same fields and prints the speed of both
+void benchmarkSplitters(const std::string& gtfsPath) {
+    std::cout << "[TEST] Benchmarking " << csvLoader::detail::bestSplitterName() << " splitter on stop_times.txt"
+              << std::endl;
+    csvLoader::MappedFile file(gtfsPath + "/stop_times.txt");
+    if (!file.isOpen()) {
+        std::cout << "[TEST] Could not open stop_times.txt, skipping" << std::endl;
+        return;
+    }
+
+    std::vector<std::string_view> records;
+    csvLoader::forEachRecord(file.view(), [&records](std::string_view line) {
+        records.push_back(line);
+        return true;
+    });
+
+    std::vector<std::string_view> scalar, vectorized;
+    uint64_t mismatches = 0;
+    for (auto line : records) {
+        csvLoader::splitScalar(line, scalar);
+        csvLoader::split(line, vectorized);
+        if (scalar != vectorized) mismatches++;
+    }
+
+    size_t fieldCount = 0;
+    auto timeSplitter = [&records, &fieldCount](auto splitter) {
+        std::vector<std::string_view> fields;
+        fieldCount = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (auto line : records) {
+            splitter(line, fields, std::string_view::npos);
+            fieldCount += fields.size();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return duration_cast<std::chrono::microseconds>(stop - start).count();
+    };
+
+    auto scalarUs = timeSplitter(csvLoader::splitScalar);
+    auto vectorizedUs = timeSplitter(csvLoader::split);
+    double improvement = static_cast<double>(scalarUs) / static_cast<double>(std::max<int64_t>(vectorizedUs, 1));
+
+    std::cout << "[TEST] [" << records.size() << " lines, " << fieldCount << " fields] [SCALAR=" << scalarUs << "µs] ["
+              << csvLoader::detail::bestSplitterName() << "=" << vectorizedUs << "µs] [" << improvement << "x speed] "
+              << (mismatches == 0 ? "[SAME FIELDS]" : "[" + std::to_string(mismatches) + " LINES DIFFER]")
+              << std::endl;
+}
+
 #define TEST_LOAD(name) testLoad<name>(name::load, #name)
 
 void test() {
@@ -87,6 +276,9 @@ void test() {
     TEST_LOAD(Transfer);
     TEST_LOAD(Trip);
 
+    benchmarkParsers("data/raw");
+    benchmarkSplitters("data/raw");
+
     auto stopAll = std::chrono::high_resolution_clock::now();
     auto duration = duration_cast<std::chrono::milliseconds>(stopAll - startAll);
     std::cout << "[TEST] Test finished in " << duration.count() << "ms" << std::endl;
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -73,9 +74,9 @@ struct Calendar {
 struct CalendarDate {
     ServiceId serviceId;
     Date date;
-    bool exceptionType;
+    int32_t exceptionType;  // 1 if service is added on the date, 2 if it is removed
 
-    CalendarDate(ServiceId service_id, Date date, bool exception_type)
+    CalendarDate(ServiceId service_id, Date date, int32_t exception_type)
         : serviceId(service_id), date(date), exceptionType(exception_type) {}
 
     static std::vector<CalendarDate> load(const std::string& gtfsPath);
@@ -130,6 +131,9 @@ struct Shape {
           shapeDistTravelled(shapeDistTravelled) {}
 
     static std::vector<Shape> load(const std::string& gtfsPath);
+
+    // Passes every shape point to callback in file order, without keeping them all in memory
+    static bool forEach(const std::string& gtfsPath, const std::function<void(Shape&&)>& callback);
 };
 
 struct StopTime {
@@ -159,6 +163,9 @@ struct StopTime {
           timepoint(timepoint) {}
 
     static std::vector<StopTime> load(const std::string& gtfsPath);
+
+    // Passes every stop time to callback in file order, without keeping them all in memory
+    static bool forEach(const std::string& gtfsPath, const std::function<void(StopTime&&)>& callback);
 };
 
 struct Stop {
@@ -14,39 +14,43 @@ using namespace routing;
 
 const routing::RoutingOptions routingOptions(10 * 60 * 60, 20221118, 60 * 60);
 
-static std::vector<IncomingTrip> extractPath(Timetable& timetable, StopId stopId,
-                                      std::unordered_map<StopId, StopState>& graph) {
+static std::vector<IncomingTrip> extractPath(Timetable& timetable, StopIdx stopId, std::vector<StopState>& graph) {
     if (graph[stopId].incoming.empty()) return {};
     StopState* current = &graph.at(stopId);
-    TripId currentTrip = current->incoming.front().tripId;
+    TripIdx currentTrip = current->incoming.front().trip;
     std::vector<IncomingTrip> legs;
     while (!current->incoming.empty()) {
         IncomingTrip from = current->incoming[0];
         for (const IncomingTrip& node : current->incoming) {
-            if (node.tripId == currentTrip && currentTrip != WALK) {
+            if (node.trip == currentTrip && currentTrip != WALK) {
                 from = node;
                 break;
             }
         }
-        currentTrip = from.tripId;
+        currentTrip = from.trip;
         legs.push_back(from);
-        current = &graph[from.from->stopId];
+        current = &graph[from.from];
     }
     std::reverse(legs.begin(), legs.end());
     return legs;
 }
 
-static void printPath(Timetable& timetable, StopId stopId, std::unordered_map<StopId, StopState>& graph) {
+static void printPath(Timetable& timetable, StopId gtfsStopId, std::vector<StopState>& graph) {
+    StopIdx stopId = timetable.stopIndex.at(gtfsStopId);
     auto path = extractPath(timetable, stopId, graph);
     std::stringstream result;
 
     for (const auto& leg : path) {
-        RouteId currentRouteId = timetable.trips[leg.tripId].routeId;
-        result << (leg.tripId == WALK ? "Walk from " + leg.from->name : timetable.routes[currentRouteId].routeShortName)
-               << ", ";
+        RouteId currentRouteId = timetable.trips[leg.trip].routeId;
+        if (leg.trip == WALK) {
+            result << "Walk from " << timetable.strings[timetable.stops[leg.from].name] << ", ";
+        } else {
+            result << timetable.strings[timetable.routes[currentRouteId].routeShortName] << ", ";
+        }
     }
 
-    std::cout << timetable.stops[stopId].name << ": " << graph[stopId].travelTime / 60 << " min" << std::endl;
+    std::cout << timetable.strings[timetable.stops[stopId].name] << ": " << graph[stopId].travelTime / 60 << " min"
+              << std::endl;
     std::cout << result.str() << std::endl;
 }
 
@@ -56,7 +60,7 @@ int main() {
     std::cout << "Timetable loaded" << std::endl;
 
     auto start = std::chrono::high_resolution_clock::now();
-    auto result = timetable.dijkstra(9021014001360000, routingOptions);
+    auto result = timetable.dijkstra(timetable.stopIndex.at(9021014001360000), routingOptions);
     auto stop = std::chrono::high_resolution_clock::now();
 
     auto duration = duration_cast<std::chrono::microseconds>(stop - start);
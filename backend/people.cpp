@@ -202,8 +202,8 @@ std::function<bool(MeterCoord)> People::euclideanPredicate(MeterCoord origin, in
 
 std::vector<Person> People::load(const std::string& rawPersonPath) {
     std::vector<RawPerson> rawPersons =
-        csvLoader::load<RawPerson, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t>(
-            rawPersonPath);
+        csvLoader::parallelLoad<RawPerson, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t,
+                                int32_t>(rawPersonPath);
 
     for (auto p : rawPersons) {
         MeterCoord work_coord = MeterCoord(p.XKOORD_Ast, p.YKOORD_Ast);
@@ -0,0 +1,177 @@
+// Writes a synthetic population file in the same layout as the SCB file data/raw/Ast_bost.txt, so that People and E2EE
+// can be run without the confidential data. Homes and workplaces are placed around the stops of a GTFS feed.
+//
+// Usage: populationGenerator <output file> <gtfs path> [--people n] [--clustering p] [--radius m] [--seed n]
+//
+// --clustering is the share of homes and workplaces placed near a stop, the rest are spread evenly over the area the
+// feed covers. --radius is the standard deviation in meters of the distance from that stop. The same arguments and
+// feed always give byte for byte the same file.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtfsTypes.h"
+#include "people.h"
+#include "synthetic.h"
+
+namespace {
+using synthetic::CsvWriter;
+using synthetic::Random;
+
+struct Options {
+    std::string output;
+    std::string gtfsPath;
+    int64_t people = 1000000;
+    double clustering = 0.8;
+    double radius = 400;
+    uint64_t seed = 1;
+};
+
+struct Municipality {
+    int32_t county;
+    int32_t code;
+    DMSCoord center;
+};
+
+// The municipalities around Gothenburg. Every coordinate is assigned to the one with the closest center.
+const Municipality municipalities[] = {
+    {14, 1480, {57.7089, 11.9746}}, {14, 1481, {57.6554, 12.0138}}, {14, 1482, {57.8710, 11.9805}},
+    {14, 1402, {57.7395, 12.1064}}, {14, 1401, {57.6920, 12.2900}}, {14, 1441, {57.7705, 12.2690}},
+    {14, 1440, {57.9266, 12.0827}}, {14, 1489, {57.9300, 12.5334}}, {14, 1415, {58.0705, 11.8181}},
+    {14, 1407, {57.7100, 11.6500}}, {14, 1490, {57.7210, 12.9401}}, {14, 1488, {58.2837, 12.2886}},
+    {14, 1485, {58.3498, 11.9381}}, {14, 1487, {58.3807, 12.3234}}, {13, 1384, {57.4875, 12.0761}},
+};
+
+struct Area {
+    MeterCoord low, high;
+};
+
+class Population {
+   public:
+    Population(const Options& options, std::vector<MeterCoord> stops)
+        : options(options), random(options.seed), stops(std::move(stops)) {
+        for (const auto& m : municipalities) centers.push_back(m.center.toMeter());
+
+        area = {this->stops[0], this->stops[0]};
+        for (const MeterCoord& stop : this->stops) {
+            area.low = {std::min(area.low.x, stop.x), std::min(area.low.y, stop.y)};
+            area.high = {std::max(area.high.x, stop.x), std::max(area.high.y, stop.y)};
+        }
+        area.low = {area.low.x - 2000, area.low.y - 2000};
+        area.high = {area.high.x + 2000, area.high.y + 2000};
+
+        // Some stops are much more common workplaces than others. Shuffle so that popularity is not tied to the stop id.
+        workplaces = this->stops;
+        for (size_t i = workplaces.size() - 1; i > 0; i--) {
+            std::swap(workplaces[i], workplaces[random.below(static_cast<uint32_t>(i + 1))]);
+        }
+    }
+
+    void write() {
+        CsvWriter out(options.output,
+                      "kon,Lan_Ast,Kommun_Ast,XKOORD_Ast,YKOORD_Ast,Lan_Bost,Kommun_Bost,XKOORD_Bost,YKOORD_Bost");
+
+        for (int64_t i = 0; i < options.people; i++) {
+            MeterCoord home = random.chance(options.clustering)
+                                  ? near(stops[random.below(static_cast<uint32_t>(stops.size()))], options.radius)
+                                  : anywhere();
+
+            MeterCoord work;
+            if (random.chance(0.15)) {
+                // Working close to home
+                work = near(home, 1500);
+            } else if (random.chance(options.clustering)) {
+                double u = random.real();
+                work = near(workplaces[static_cast<size_t>(u * u * u * static_cast<double>(workplaces.size()))],
+                            options.radius);
+            } else {
+                work = anywhere();
+            }
+
+            const Municipality& workMunicipality = municipalityOf(work);
+            const Municipality& homeMunicipality = municipalityOf(home);
+            out << random.between(1, 2);
+            out << workMunicipality.county << workMunicipality.code << work.x << work.y;
+            out << homeMunicipality.county << homeMunicipality.code << home.x << home.y;
+            out.endRow();
+        }
+    }
+
+   private:
+    // People are counted in 100 m squares, at the center of each square
+    static int32_t snap(double meters) { return static_cast<int32_t>(std::floor(meters / 100)) * 100 + 50; }
+
+    MeterCoord near(MeterCoord origin, double sigma) {
+        return {snap(origin.x + random.normal() * sigma), snap(origin.y + random.normal() * sigma)};
+    }
+
+    MeterCoord anywhere() {
+        return {snap(area.low.x + random.real() * (area.high.x - area.low.x)),
+                snap(area.low.y + random.real() * (area.high.y - area.low.y))};
+    }
+
+    const Municipality& municipalityOf(MeterCoord coord) const {
+        size_t best = 0;
+        for (size_t i = 1; i < centers.size(); i++) {
+            if (coord.distanceTo(centers[i]) < coord.distanceTo(centers[best])) best = i;
+        }
+        return municipalities[best];
+    }
+
+    const Options& options;
+    Random random;
+    std::vector<MeterCoord> stops;
+    std::vector<MeterCoord> workplaces;
+    std::vector<MeterCoord> centers;
+    Area area;
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    if (argc < 3) return false;
+    options.output = argv[1];
+    options.gtfsPath = argv[2];
+
+    for (int i = 3; i < argc; i += 2) {
+        if (i + 1 >= argc) return false;
+        std::string_view key = argv[i];
+        const char* value = argv[i + 1];
+        if (key == "--people") options.people = std::atoll(value);
+        else if (key == "--clustering") options.clustering = std::atof(value);
+        else if (key == "--radius") options.radius = std::atof(value);
+        else if (key == "--seed") options.seed = std::strtoull(value, nullptr, 10);
+        else return false;
+    }
+    return options.people > 0 && options.clustering >= 0 && options.clustering <= 1 && options.radius >= 0;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <output file> <gtfs path> [--people n] [--clustering p] [--radius m] [--seed n]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Stop areas, or every stop if the feed has no areas
+    std::vector<MeterCoord> stops, points;
+    for (const auto& stop : gtfs::Stop::load(options.gtfsPath)) {
+        MeterCoord coord = DMSCoord(stop.stopLat, stop.stopLon).toMeter();
+        (stop.locationType == 1 ? stops : points).push_back(coord);
+    }
+    if (stops.empty()) stops = std::move(points);
+    if (stops.empty()) {
+        std::cerr << "[ERROR!] No stops found in " << options.gtfsPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Writing " << options.people << " people around " << stops.size() << " stops to " << options.output
+              << std::endl;
+    Population(options, std::move(stops)).write();
+    return 0;
+}
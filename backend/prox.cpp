@@ -9,14 +9,14 @@
 using namespace gtfs;
 
 Prox::Prox(const routing::Timetable& timetable) {
-    for (auto& [stopId, stopNode] : timetable.stops) {
-        stops.emplace_back(DMSCoord(stopNode.lat, stopNode.lon), stopId);
+    for (const auto& stopNode : timetable.stops) {
+        stops.emplace_back(DMSCoord(stopNode.lat, stopNode.lon), stopNode.index);
     }
     std::sort(stops.begin(), stops.end(), [](const auto& a, const auto& b) { return stopComparator(a, b); });
 }
 
-std::vector<std::pair<StopId, double>> Prox::stopsAroundDMSCoord(const DMSCoord& coord, double range) const {
-    std::vector<std::pair<StopId, double>> found;
+std::vector<std::pair<routing::StopIdx, double>> Prox::stopsAroundDMSCoord(const DMSCoord& coord, double range) const {
+    std::vector<std::pair<routing::StopIdx, double>> found;
 
     DMSCoord lowerCoord = {coord.latitude - meterToDegreeLat(range),
                            coord.longitude - meterToDegreeLon(range, coord.latitude)};
@@ -79,14 +79,15 @@ bool Prox::stopComparator(const StopCoord& lhs, const StopCoord& rhs) {
     return lhs.first.longitude < rhs.first.longitude;
 }
 
-std::vector<std::pair<StopId, double>> Prox::stopsAroundMeterCoord(const MeterCoord mCoord, double range) const {
+std::vector<std::pair<routing::StopIdx, double>> Prox::stopsAroundMeterCoord(const MeterCoord mCoord,
+                                                                           double range) const {
     return stopsAroundDMSCoord(mCoord.toDMS(), range);
 }
 
-std::vector<std::pair<StopId, double>>
+std::vector<std::pair<routing::StopIdx, double>>
 Prox::stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
     const DMSCoord& coord, uint32_t range, double mysticFactor) const {
-    std::vector<std::pair<StopId, double>> found;
+    std::vector<std::pair<routing::StopIdx, double>> found;
 
     DMSCoord lowerCoord = {coord.latitude - meterToDegreeLat(range),
                            coord.longitude - meterToDegreeLon(range, coord.latitude)};
@@ -113,7 +114,7 @@ Prox::stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithin
     return found;
 }
 
-std::vector<std::pair<StopId, double>>
+std::vector<std::pair<routing::StopIdx, double>>
 Prox::stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
     const MeterCoord& coord, uint32_t range, double mysticFactor) const {
     return stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
@@ -10,23 +10,23 @@
 #include "people.h"
 #include "routing.h"
 
-using StopCoord = std::pair<DMSCoord, StopId>;
+using StopCoord = std::pair<DMSCoord, routing::StopIdx>;
 
 class Prox {
    public:
     Prox(const routing::Timetable& timetable);
 
-    std::vector<std::pair<StopId, double>>
+    std::vector<std::pair<routing::StopIdx, double>>
     stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
         const MeterCoord& coord, uint32_t range, double mysticFactor) const;
 
-    std::vector<std::pair<StopId, double>>
+    std::vector<std::pair<routing::StopIdx, double>>
     stopsIDAndDistanceMultipliedWithAFactorWhichInFactIsJustTheWalkSpeedWithinACertainRangeInclusiveButRounded(
         const DMSCoord& coord, uint32_t range, double mysticFactor) const;
 
-    std::vector<std::pair<StopId, double>> stopsAroundDMSCoord(const DMSCoord& coord, double range) const;
+    std::vector<std::pair<routing::StopIdx, double>> stopsAroundDMSCoord(const DMSCoord& coord, double range) const;
 
-    std::vector<std::pair<StopId, double>> stopsAroundMeterCoord(const MeterCoord mCoord, double range) const;
+    std::vector<std::pair<routing::StopIdx, double>> stopsAroundMeterCoord(const MeterCoord mCoord, double range) const;
 
     std::vector<StopCoord> stops;
 
@@ -0,0 +1,241 @@
+// RAPTOR, a round based search over route patterns. Each round scans every pattern calling at a stop that improved in
+// the round before once, from the first such stop to the end of the pattern, and then walks the transfers from the
+// stops it improved. There is no priority queue and no edge lists, the patterns are read stop by stop from
+// Timetable::patternTimes. Timetable::profile runs it once per departure over a window, as rRAPTOR.
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "routing.h"
+
+namespace routing {
+
+namespace {
+
+const uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+
+int32_t minTransferTime(const RoutingOptions& options, const StopNode& stop) {
+    return options.overrideMinTransferTime ? options.minTransferTime : stop.minTransferTime;
+}
+
+// Adds a trip arriving at a stop that is not the best way there, so that a path along the trip can still be followed
+// backwards from a later stop, as E2EE's extractShape does
+void addAlternative(StopState& state, IncomingTrip incoming) {
+    if (std::none_of(state.incoming.begin(), state.incoming.end(),
+                     [&incoming](const IncomingTrip& t) { return t.trip == incoming.trip; })) {
+        state.incoming.push_back(incoming);
+    }
+}
+
+}  // namespace
+
+std::vector<StopState> Timetable::raptor(StopIdx start, const RoutingOptions& options) {
+    std::vector<StopState> state(stops.size());
+    raptorSearch(start, options.startTime, options, state);
+    for (StopState& stopState : state) stopState.visited = stopState.reached();
+    return state;
+}
+
+void Timetable::raptorSearch(StopIdx start, int32_t departure, const RoutingOptions& options,
+                             std::vector<StopState>& state) {
+    int32_t day = calendar.day(options.date);
+
+    // Stops improved in the previous round, which trips can be boarded at, and in the current one
+    std::vector<StopIdx> marked, improved;
+    std::vector<char> isMarked(stops.size()), isImproved(stops.size());
+
+    auto arrive = [&](StopIdx stop, int32_t time, int32_t initialWaitTime, IncomingTrip incoming) {
+        StopState& to = state[stop];
+        if (time - options.startTime >= to.travelTime) return false;
+        to.travelTime = time - options.startTime;
+        to.initialWaitTime = initialWaitTime;
+        to.incoming.insert(to.incoming.begin(), incoming);
+        if (!isImproved[stop]) {
+            isImproved[stop] = true;
+            improved.push_back(stop);
+        }
+        return true;
+    };
+
+    // Transfers may be chained, like in dijkstra, so stops reached by walking are walked on from as well
+    std::vector<StopIdx> walkFrom;
+    auto walk = [&]() {
+        walkFrom.assign(improved.begin(), improved.end());
+        while (!walkFrom.empty()) {
+            StopIdx from = walkFrom.back();
+            walkFrom.pop_back();
+            for (const Edge& transfer : stops[from].transfersType2) {
+                if (arrive(transfer.to, options.startTime + state[from].travelTime + transfer.cost,
+                           state[from].initialWaitTime, IncomingTrip(from, transfer.trip, transfer.stopSequence))) {
+                    walkFrom.push_back(transfer.to);
+                }
+            }
+        }
+    };
+
+    // The earliest time a trip can be boarded at a stop reached in the previous round
+    auto readyTime = [&](StopIdx stop) {
+        int32_t time = options.startTime + state[stop].travelTime;
+        return stop == start ? time : time + minTransferTime(options, stops[stop]);
+    };
+
+    auto initialWaitTime = [&](StopIdx boardStop, int32_t departureTime) {
+        return boardStop == start ? departureTime - departure : state[boardStop].initialWaitTime;
+    };
+
+    state[start].travelTime = departure - options.startTime;
+    state[start].initialWaitTime = 0;
+    isImproved[start] = true;
+    improved.push_back(start);
+    walk();
+
+    std::vector<uint32_t> patternFrom(routePatterns.size(), NO_POSITION);
+    std::vector<PatternIdx> queued;
+    while (!improved.empty() && day >= 0) {
+        for (StopIdx stop : marked) isMarked[stop] = false;
+        marked.swap(improved);
+        improved.clear();
+        for (StopIdx stop : marked) {
+            isImproved[stop] = false;
+            isMarked[stop] = true;
+        }
+
+        // Every pattern once, from the first stop of it that was improved
+        for (StopIdx stop : marked) {
+            for (const PatternStop& ps : patternsAt(stop)) {
+                if (patternFrom[ps.pattern] == NO_POSITION) queued.push_back(ps.pattern);
+                patternFrom[ps.pattern] = std::min(patternFrom[ps.pattern], ps.position);
+            }
+        }
+
+        for (PatternIdx pattern : queued) {
+            const RoutePattern& p = routePatterns[pattern];
+            auto patternStopList = patternStopsOf(pattern);
+            auto patternTripList = patternTripsOf(pattern);
+
+            uint32_t trip = NO_POSITION;  // index of the trip ridden within the pattern
+            int32_t boardWaitTime = 0;
+            uint32_t alternativesUpTo = 0;  // positions before it have an incoming trip for the ridden trip
+
+            for (uint32_t position = patternFrom[pattern]; position < p.stopCount; position++) {
+                StopIdx stop = patternStopList[position];
+                auto times = patternTimesAt(pattern, position);
+
+                if (trip != NO_POSITION) {
+                    IncomingTrip incoming(patternStopList[position - 1], patternTripList[trip],
+                                          static_cast<int32_t>(position) + 1);
+                    if (arrive(stop, times[trip].arrivalTime, boardWaitTime, incoming)) {
+                        for (uint32_t before = alternativesUpTo; before < position; before++) {
+                            addAlternative(state[patternStopList[before]],
+                                           IncomingTrip(patternStopList[before - 1], patternTripList[trip],
+                                                        static_cast<int32_t>(before) + 1));
+                        }
+                        alternativesUpTo = position + 1;
+                    }
+                }
+
+                // Board an earlier trip if one can be caught here, the first one that runs within the search time
+                if (!isMarked[stop] || position + 1 == p.stopCount) continue;
+                int32_t ready = readyTime(stop);
+                auto end = trip == NO_POSITION ? times.end() : times.begin() + trip;
+                auto departsBefore = [](const PatternTime& t, int32_t time) { return t.departureTime < time; };
+                auto candidate = std::lower_bound(times.begin(), end, ready, departsBefore);
+                for (; candidate != end && candidate->departureTime < ready + options.searchTime; candidate++) {
+                    if (!calendar.runs(trips[patternTripList[candidate - times.begin()]].calendar, day)) continue;
+                    trip = static_cast<uint32_t>(candidate - times.begin());
+                    boardWaitTime = initialWaitTime(stop, candidate->departureTime);
+                    alternativesUpTo = position + 1;
+                    break;
+                }
+            }
+            patternFrom[pattern] = NO_POSITION;
+        }
+        queued.clear();
+
+        // Trips that wait for the trip a stop was reached with, see StopNode::handleTransferType1
+        for (StopIdx stop : marked) {
+            if (state[stop].incoming.empty() || state[stop].incoming[0].trip == WALK) continue;
+            auto transfers = stops[stop].transfersType1.find(state[stop].incoming[0].trip);
+            if (transfers == stops[stop].transfersType1.end()) continue;
+
+            int32_t arrival = options.startTime + state[stop].travelTime;
+            for (TripIdx toTrip : transfers->second) {
+                if (!calendar.runs(trips[toTrip].calendar, day)) continue;
+                auto events = tripEvents(toTrip);
+                uint32_t position = 0;
+                while (position < events.size() &&
+                       (events[position].stop != stop || events[position].departureTime < arrival)) {
+                    position++;
+                }
+                while (position + 1 < events.size() && events[position + 1].stop == stop) position++;
+                if (position + 1 >= events.size()) continue;
+
+                int32_t waitTime = initialWaitTime(stop, events[position].departureTime);
+                uint32_t alternativesUpTo = position + 1;
+                for (uint32_t next = position + 1; next < events.size(); next++) {
+                    if (!arrive(events[next].stop, events[next].arrivalTime, waitTime,
+                                IncomingTrip(events[next - 1].stop, toTrip, static_cast<int32_t>(next) + 1))) {
+                        continue;
+                    }
+                    for (uint32_t before = alternativesUpTo; before < next; before++) {
+                        addAlternative(state[events[before].stop],
+                                       IncomingTrip(events[before - 1].stop, toTrip, static_cast<int32_t>(before) + 1));
+                    }
+                    alternativesUpTo = next + 1;
+                }
+            }
+        }
+
+        walk();
+    }
+
+    state[start].incoming.clear();
+}
+
+std::vector<std::vector<ProfileEntry>> Timetable::profile(StopIdx start, const RoutingOptions& options,
+                                                         int32_t window) {
+    std::vector<std::vector<ProfileEntry>> profiles(stops.size());
+    int32_t day = calendar.day(options.date);
+    if (day < 0) return profiles;
+
+    // Only leaving just in time for a trip from start, or from a stop a transfer away, can get anywhere earlier than
+    // leaving later does
+    std::vector<int32_t> departures;
+    auto addDepartures = [&](StopIdx stop, int32_t walkTime) {
+        for (const PatternStop& ps : patternsAt(stop)) {
+            if (ps.position + 1 == routePatterns[ps.pattern].stopCount) continue;
+            auto times = patternTimesAt(ps.pattern, ps.position);
+            auto patternTripList = patternTripsOf(ps.pattern);
+            auto departsBefore = [](const PatternTime& t, int32_t time) { return t.departureTime < time; };
+            auto time = std::lower_bound(times.begin(), times.end(), options.startTime + walkTime, departsBefore);
+            for (; time != times.end() && time->departureTime - walkTime <= options.startTime + window; time++) {
+                if (!calendar.runs(trips[patternTripList[time - times.begin()]].calendar, day)) continue;
+                departures.push_back(time->departureTime - walkTime);
+            }
+        }
+    };
+    addDepartures(start, 0);
+    for (const Edge& transfer : stops[start].transfersType2) {
+        addDepartures(transfer.to, transfer.cost + minTransferTime(options, stops[transfer.to]));
+    }
+    std::sort(departures.begin(), departures.end(), std::greater<>());
+    departures.erase(std::unique(departures.begin(), departures.end()), departures.end());
+
+    // A stop that a search improves on gets there earlier than leaving at any later departure does
+    std::vector<StopState> state(stops.size());
+    for (int32_t departure : departures) {
+        raptorSearch(start, departure, options, state);
+        for (StopIdx stop = 0; stop < stops.size(); stop++) {
+            if (stop == start || !state[stop].reached()) continue;
+            int32_t arrival = options.startTime + state[stop].travelTime;
+            if (profiles[stop].empty() || arrival < profiles[stop].back().arrivalTime) {
+                profiles[stop].push_back({departure, arrival});
+            }
+        }
+    }
+    for (auto& stopProfile : profiles) std::reverse(stopProfile.begin(), stopProfile.end());
+    return profiles;
+}
+
+}  // namespace routing
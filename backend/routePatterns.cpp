@@ -0,0 +1,102 @@
+// Grouping of trips into route patterns, the layout that round and scan based algorithms like RAPTOR work on.
+
+#include <algorithm>
+#include <numeric>
+#include <ranges>
+
+#include "routing.h"
+
+namespace routing {
+
+void Timetable::buildRoutePatterns() {
+    routePatterns.clear();
+    patternStops.clear();
+    patternTrips.clear();
+    patternTimes.clear();
+
+    // Trips with the same stops next to each other, and within those ordered by their times along the trip
+    auto stopsOf = [this](TripIdx trip) {
+        auto events = tripEvents(trip);
+        return std::views::transform(events, [](const StopEvent& e) { return e.stop; });
+    };
+    auto timesBefore = [this](TripIdx a, TripIdx b) {
+        auto ea = tripEvents(a), eb = tripEvents(b);
+        for (size_t i = 0; i < ea.size(); i++) {
+            if (ea[i].departureTime != eb[i].departureTime) return ea[i].departureTime < eb[i].departureTime;
+            if (ea[i].arrivalTime != eb[i].arrivalTime) return ea[i].arrivalTime < eb[i].arrivalTime;
+        }
+        return a < b;
+    };
+
+    std::vector<TripIdx> order;
+    for (TripIdx trip = 1; trip < trips.size(); trip++) {
+        trips[trip].pattern = NO_PATTERN;
+        if (!tripEvents(trip).empty()) order.push_back(trip);
+    }
+    std::sort(order.begin(), order.end(), [&](TripIdx a, TripIdx b) {
+        auto sa = stopsOf(a), sb = stopsOf(b);
+        if (!std::ranges::equal(sa, sb)) return std::ranges::lexicographical_compare(sa, sb);
+        return timesBefore(a, b);
+    });
+
+    // A trip that overtakes another one, or is overtaken, goes in a pattern of its own. Every group of trips with the
+    // same stops is split into as few patterns as possible where all trips are in order at every stop.
+    auto inOrder = [this](TripIdx earlier, TripIdx later) {
+        auto ea = tripEvents(earlier), el = tripEvents(later);
+        for (size_t i = 0; i < ea.size(); i++) {
+            if (ea[i].arrivalTime > el[i].arrivalTime || ea[i].departureTime > el[i].departureTime) return false;
+        }
+        return true;
+    };
+
+    std::vector<std::vector<TripIdx>> groupPatterns;
+    for (size_t begin = 0; begin < order.size();) {
+        size_t end = begin + 1;
+        while (end < order.size() && std::ranges::equal(stopsOf(order[begin]), stopsOf(order[end]))) end++;
+
+        groupPatterns.clear();
+        for (size_t i = begin; i < end; i++) {
+            auto fits = std::find_if(groupPatterns.begin(), groupPatterns.end(),
+                                     [&](const auto& p) { return inOrder(p.back(), order[i]); });
+            if (fits == groupPatterns.end()) fits = groupPatterns.emplace(groupPatterns.end());
+            fits->push_back(order[i]);
+        }
+
+        auto calls = tripEvents(order[begin]);
+        for (const auto& tripsOfPattern : groupPatterns) {
+            auto pattern = static_cast<PatternIdx>(routePatterns.size());
+            routePatterns.push_back({static_cast<uint32_t>(patternStops.size()),
+                                     static_cast<uint32_t>(patternTrips.size()),
+                                     static_cast<uint32_t>(patternTimes.size()), static_cast<uint32_t>(calls.size()),
+                                     static_cast<uint32_t>(tripsOfPattern.size())});
+            for (const StopEvent& e : calls) patternStops.push_back(e.stop);
+            for (TripIdx trip : tripsOfPattern) {
+                patternTrips.push_back(trip);
+                trips[trip].pattern = pattern;
+            }
+            for (size_t position = 0; position < calls.size(); position++) {
+                for (TripIdx trip : tripsOfPattern) {
+                    const StopEvent& e = tripEvents(trip)[position];
+                    patternTimes.push_back({e.arrivalTime, e.departureTime});
+                }
+            }
+        }
+        begin = end;
+    }
+
+    // Patterns by stop, with a counting sort
+    stopPatternOffsets.assign(stops.size() + 1, 0);
+    for (StopIdx stop : patternStops) stopPatternOffsets[stop + 1]++;
+    std::partial_sum(stopPatternOffsets.begin(), stopPatternOffsets.end(), stopPatternOffsets.begin());
+
+    stopPatterns.resize(patternStops.size());
+    std::vector<uint32_t> next(stopPatternOffsets.begin(), stopPatternOffsets.end() - 1);
+    for (PatternIdx pattern = 0; pattern < routePatterns.size(); pattern++) {
+        auto patternStopList = patternStopsOf(pattern);
+        for (uint32_t position = 0; position < patternStopList.size(); position++) {
+            stopPatterns[next[patternStopList[position]]++] = {pattern, position};
+        }
+    }
+}
+
+}  // namespace routing
@@ -4,37 +4,77 @@
 #include <functional>
 #include <iostream>
 #include <queue>
-#include <set>
+#include <stdexcept>
 #include <vector>
 
 #include "gtfsTypes.h"
+#include "threadPool.h"
 
 using namespace routing;
 
-inline int32_t getMinTransferTime(const RoutingOptions& options, StopNode* stop) {
-    return options.overrideMinTransferTime ? options.minTransferTime : stop->minTransferTime;
+inline int32_t getMinTransferTime(const RoutingOptions& options, const StopNode& stop) {
+    return options.overrideMinTransferTime ? options.minTransferTime : stop.minTransferTime;
 }
 
-std::unordered_map<StopId, StopState> Timetable::dijkstra(StopId start, const RoutingOptions& options) {
-    std::unordered_map<StopId, std::vector<DestinationEdge>> destinationEdges;
+std::vector<StopState> Timetable::dijkstra(StopIdx start, const RoutingOptions& options) {
+    std::unordered_map<StopIdx, std::vector<DestinationEdge>> destinationEdges;
     return dijkstra(start, options, destinationEdges);
 }
 
-std::unordered_map<StopId, StopState> Timetable::dijkstra(
-    StopId start, const RoutingOptions& options,
-    std::unordered_map<StopId, std::vector<DestinationEdge>>& destinationEdges) {
-    std::unordered_map<StopId, StopState> state;
+std::vector<StopState> Timetable::dijkstra(StopIdx start, const RoutingOptions& options, const SearchLimits& limits,
+                                          SearchCounters* counters) {
+    std::unordered_map<StopIdx, std::vector<DestinationEdge>> destinationEdges;
+    return dijkstra(start, options, destinationEdges, limits, counters);
+}
+
+std::vector<StopState> Timetable::route(StopIdx start, const RoutingOptions& options) {
+    if (options.engine == RoutingEngine::RAPTOR) return raptor(start, options);
+    if (options.engine == RoutingEngine::CSA) return connectionScan(start, options);
+    return dijkstra(start, options);
+}
+
+std::vector<StopState> Timetable::route(StopIdx start, const RoutingOptions& options, const SearchLimits& limits,
+                                        SearchCounters* counters) {
+    if (options.engine == RoutingEngine::DIJKSTRA) return dijkstra(start, options, limits, counters);
+    if (options.engine == RoutingEngine::CSA) return connectionScan(start, options, limits, counters);
+    return route(start, options);
+}
+
+std::vector<StopState> Timetable::dijkstra(StopIdx start, const RoutingOptions& options,
+                                           std::unordered_map<StopIdx, std::vector<DestinationEdge>>& destinationEdges,
+                                           const SearchLimits& limits, SearchCounters* counters) {
+    std::vector<StopState> state(stops.size());
+
+    // A settled stop can still get alternative trips from stops up to its minimum transfer time later, so the search
+    // goes on for that long after the last target
+    std::vector<char> isTarget;
+    size_t targetsLeft = 0;
+    int32_t transferSlack = options.minTransferTime;
+    if (!limits.targets.empty()) {
+        isTarget.resize(stops.size());
+        for (StopIdx target : limits.targets) {
+            targetsLeft += !isTarget[target];
+            isTarget[target] = true;
+        }
+        if (!options.overrideMinTransferTime) {
+            transferSlack = 0;
+            for (const StopNode& stop : stops) transferSlack = std::max(transferSlack, stop.minTransferTime);
+        }
+    }
+    int32_t stopAfter = limits.maxTravelTime;
+    bool stoppedEarly = false;
+    std::shared_ptr<const ActiveDepartures> active = activeDepartures(options.date);
 
-    auto compare = [](std::pair<StopNode*, StopState*> a, std::pair<StopNode*, StopState*> b) {
+    auto compare = [](std::pair<StopIdx, StopState*> a, std::pair<StopIdx, StopState*> b) {
         return a.second->travelTime > b.second->travelTime;
     };
-    std::priority_queue<std::pair<StopNode*, StopState*>, std::vector<std::pair<StopNode*, StopState*>>,
+    std::priority_queue<std::pair<StopIdx, StopState*>, std::vector<std::pair<StopIdx, StopState*>>,
                         decltype(compare)>
         queue;
 
-    state[start].travelTime = 0;
+    state.at(start).travelTime = 0;
 
-    queue.emplace(&stops.at(start), &state[start]);
+    queue.emplace(start, &state[start]);
 
     while (!queue.empty()) {
         auto [node, nodeState] = queue.top();
@@ -42,42 +82,55 @@ std::unordered_map<StopId, StopState> Timetable::dijkstra(
 
         // Ignore duplicates
         if (nodeState->visited && !nodeState->revisit) continue;
+        // The queue holds states that can improve after they were added, so it is not always in order and stops past the
+        // limit are skipped rather than stopping the search
+        if (nodeState->travelTime > stopAfter) {
+            stoppedEarly = true;
+            continue;
+        }
+
+        if (!nodeState->visited && !isTarget.empty() && isTarget[node] && --targetsLeft == 0) {
+            stopAfter = std::min(stopAfter, nodeState->travelTime + transferSlack);
+        }
         nodeState->visited = true;
 
-        for (DestinationEdge& edge : destinationEdges[node->stopId]) {
-            int32_t newTravelTime = nodeState->travelTime + edge.cost;
-            StopState& toState = state[edge.destinationId];
-            if (newTravelTime < toState.travelTime) {
-                toState.travelTime = newTravelTime;
-                toState.incoming = {IncomingTrip(node, WALK, 0)};
+        auto destinations = destinationEdges.find(node);
+        if (destinations != destinationEdges.end()) {
+            for (DestinationEdge& edge : destinations->second) {
+                int32_t newTravelTime = nodeState->travelTime + edge.cost;
+                StopState& toState = state[edge.destination];
+                if (newTravelTime < toState.travelTime) {
+                    toState.travelTime = newTravelTime;
+                    toState.incoming = {IncomingTrip(node, WALK, 0)};
+                }
             }
         }
 
-        for (Edge& edge : node->getEdges(*this, options, nodeState, start == node->stopId)) {
+        for (Edge& edge : stops[node].getEdges(*this, *active, options, nodeState, start == node)) {
             int32_t newTravelTime = nodeState->travelTime + edge.cost;
-            StopState& toState = state[edge.to->stopId];
+            StopState& toState = state[edge.to];
 
             if (newTravelTime < toState.travelTime) {
                 toState.travelTime = newTravelTime;
-                toState.incoming.insert(toState.incoming.begin(), IncomingTrip(node, edge.tripId, edge.stopSequence));
+                toState.incoming.insert(toState.incoming.begin(), IncomingTrip(node, edge.trip, edge.stopSequence));
                 queue.emplace(edge.to, &toState);
 
-                if (start == node->stopId && edge.tripId != WALK) {
+                if (start == node && edge.trip != WALK) {
                     toState.initialWaitTime =
-                        trips[edge.tripId].stopTimes[edge.stopSequence - 2].departureTime - options.startTime;
+                        tripEvents(edge.trip)[edge.stopSequence - 2].departureTime - options.startTime;
                 } else {
                     toState.initialWaitTime = nodeState->initialWaitTime;
                 }
 
-            } else if (newTravelTime <= toState.travelTime + getMinTransferTime(options, edge.to)) {
+            } else if (newTravelTime <= toState.travelTime + getMinTransferTime(options, stops[edge.to])) {
                 // Alternative trips that may result in fewer transfers and therefore faster travel time.
 
                 // Do not add the same trip again when revisiting.
                 if (toState.revisit && std::any_of(toState.incoming.begin(), toState.incoming.end(),
-                                                   [&edge](IncomingTrip& t) { return t.tripId == edge.tripId; }))
+                                                   [&edge](IncomingTrip& t) { return t.trip == edge.trip; }))
                     continue;
 
-                toState.incoming.emplace_back(node, edge.tripId, edge.stopSequence);
+                toState.incoming.emplace_back(node, edge.trip, edge.stopSequence);
 
                 // Revisit the stop if it has already been visited.
                 if (toState.visited) {
@@ -89,103 +142,121 @@ std::unordered_map<StopId, StopState> Timetable::dijkstra(
     }
 
     state[start].incoming.clear();
+
+    uint64_t settled = 0, pruned = 0;
+    for (StopState& stopState : state) {
+        if (stopState.visited) {
+            settled++;
+        } else if (stoppedEarly && stopState.reached()) {
+            stopState = StopState();
+            pruned++;
+        }
+    }
+    if (counters != nullptr) {
+        counters->searches++;
+        counters->stoppedEarly += stoppedEarly;
+        counters->settledStops += settled;
+        counters->prunedStops += pruned;
+    }
     return state;
 }
 
-std::vector<Edge> StopNode::getEdges(Timetable& timetable, const RoutingOptions& options, StopState* state,
-                                     bool startNode) {
-    auto stop = &timetable.stopTimes[stopId];
-
+std::vector<Edge> StopNode::getEdges(Timetable& timetable, const ActiveDepartures& active,
+                                     const RoutingOptions& options, StopState* state, bool startNode) {
     std::vector<Edge> outgoingEdges;
-    std::set<uint64_t> outgoingDirections;
+    int32_t day = active.day;
 
     // Walk to another stop
     for (Edge transfer : transfersType2) outgoingEdges.push_back(transfer);
 
     // Alternative trips
-    for (IncomingTrip trip : state->incoming) {
-        if (trip.tripId == WALK) continue;
+    for (IncomingTrip incoming : state->incoming) {
+        if (incoming.trip == WALK) continue;
 
         // Transfers to trips that is waiting for this trip to arrive
-        handleTransferType1(timetable, options, state, outgoingEdges, trip.tripId);
+        handleTransferType1(timetable, options, state, outgoingEdges, incoming.trip, day);
 
-        auto& stopTimes = timetable.trips[trip.tripId].stopTimes;
+        auto events = timetable.tripEvents(incoming.trip);
 
         // Skip if final stop
-        if (trip.stopSequence >= stopTimes.size()) continue;
+        if (incoming.stopSequence < 0 || static_cast<size_t>(incoming.stopSequence) >= events.size()) continue;
 
         // Get next stop
-        StopTime& next = stopTimes[trip.stopSequence];
+        const StopEvent& next = events[incoming.stopSequence];
 
-        outgoingEdges.emplace_back(&timetable.stops[next.stopId],
-                                   next.arrivalTime - options.startTime - state->travelTime, trip.tripId,
-                                   next.stopSequence);
+        outgoingEdges.emplace_back(next.stop, next.arrivalTime - options.startTime - state->travelTime, incoming.trip,
+                                   incoming.stopSequence + 1);
     }
 
     int32_t timeAtStop =
-        startNode ? options.startTime : options.startTime + state->travelTime + getMinTransferTime(options, this);
-
-    auto compare = [](const StopTime& a, const StopTime& b) { return a.departureTime < b.departureTime; };
-    auto iter = std::lower_bound(stop->begin(), stop->end(), StopTime(timeAtStop), compare);
-
-    for (; iter < stop->end() && iter->departureTime < timeAtStop + options.searchTime; iter++) {
-        Trip* trip = &timetable.trips[iter->tripId];
-
-        // Max one departure per line and direction
-        uint64_t direction = trip->shapeId;
-        if (outgoingDirections.contains(direction)) continue;
+        startNode ? options.startTime : options.startTime + state->travelTime + getMinTransferTime(options, *this);
+
+    // Max one departure per line and direction, the first one within the search time
+    uint32_t firstPattern = active.patternOffsets[index];
+    uint32_t lastPattern = active.patternOffsets[index + 1];
+    std::vector<const PatternDeparture*> firstDepartures;
+    firstDepartures.reserve(lastPattern - firstPattern);
+    auto compare = [](const PatternDeparture& a, int32_t time) { return a.departureTime < time; };
+    for (uint32_t p = firstPattern; p < lastPattern; p++) {
+        auto pattern = active.pattern(p);
+        auto first = std::lower_bound(pattern.begin(), pattern.end(), timeAtStop, compare);
+        if (first != pattern.end() && first->departureTime < timeAtStop + options.searchTime) {
+            firstDepartures.push_back(&*first);
+        }
+    }
 
-        // Check date for departure
-        if (!timetable.calendarDates[trip->serviceId].contains(options.date)) continue;
+    // In the order they leave
+    std::sort(firstDepartures.begin(), firstDepartures.end(),
+              [](const PatternDeparture* a, const PatternDeparture* b) { return a->order < b->order; });
 
-        outgoingDirections.insert(direction);
+    for (const PatternDeparture* first : firstDepartures) {
+        const PatternDeparture& departure = *first;
+        auto events = timetable.tripEvents(departure.trip);
 
         // Skip if final stop
-        if (iter->stopSequence >= trip->stopTimes.size()) continue;
+        if (departure.stopSequence < 0 || static_cast<size_t>(departure.stopSequence) >= events.size()) continue;
 
         // Get next stop
-        StopTime& next = trip->stopTimes[iter->stopSequence];
+        const StopEvent& next = events[departure.stopSequence];
 
         // Skip departure if the next stop is the stop that you came from
-        if (!state->incoming.empty() && next.stopId == state->incoming[0].from->stopId) continue;
+        if (!state->incoming.empty() && next.stop == state->incoming[0].from) continue;
 
         // Skip departure if the next stop is another stop point at the same stop area
-        if (next.stopId == stopId) continue;
+        if (next.stop == index) continue;
 
-        outgoingEdges.emplace_back(&timetable.stops[next.stopId],
-                                   next.arrivalTime - options.startTime - state->travelTime, iter->tripId,
-                                   next.stopSequence);
+        outgoingEdges.emplace_back(next.stop, next.arrivalTime - options.startTime - state->travelTime, departure.trip,
+                                   departure.stopSequence + 1);
     }
     return outgoingEdges;
 }
 
 inline void StopNode::handleTransferType1(Timetable& timetable, const RoutingOptions& options, const StopState* state,
-                                          std::vector<Edge>& outgoingEdges, TripId tripId) {
-    auto transfers = transfersType1.find(tripId);
+                                          std::vector<Edge>& outgoingEdges, TripIdx fromTrip, int32_t day) {
+    auto transfers = transfersType1.find(fromTrip);
     if (transfers != transfersType1.end()) {
-        for (TripId toTripId : transfers->second) {
-            auto& trip = timetable.trips[toTripId];
-            auto& stopTimes = trip.stopTimes;
-            int32_t stopSequence = 0;
-            for (int i = 0; i < stopTimes.size(); i++) {
-                if (stopTimes[i].stopId == stopId &&
-                    stopTimes[i].departureTime >= options.startTime + state->travelTime) {
+        for (TripIdx toTrip : transfers->second) {
+            auto& trip = timetable.trips[toTrip];
+            auto events = timetable.tripEvents(toTrip);
+            uint32_t stopSequence = 0;
+            for (uint32_t i = 0; i < events.size(); i++) {
+                if (events[i].stop == index && events[i].departureTime >= options.startTime + state->travelTime) {
                     stopSequence = i + 1;
                     break;
                 }
             }
 
-            StopTime next = stopTimes[stopSequence];
-
             // If there are several stop times at the same stop area in a row, use the last one.
-            while (next.stopId == stopId) next = stopTimes[++stopSequence];
-            
+            while (stopSequence < events.size() && events[stopSequence].stop == index) stopSequence++;
+            if (stopSequence >= events.size()) continue;
+
+            const StopEvent& next = events[stopSequence];
+
             // Check date for departure
-            if (!timetable.calendarDates[trip.serviceId].contains(options.date)) continue;
+            if (day < 0 || !timetable.calendar.runs(trip.calendar, day)) continue;
 
-            outgoingEdges.emplace_back(&timetable.stops[next.stopId],
-                                       next.arrivalTime - options.startTime - state->travelTime, toTripId,
-                                       next.stopSequence);
+            outgoingEdges.emplace_back(next.stop, next.arrivalTime - options.startTime - state->travelTime, toTrip,
+                                       stopSequence + 1);
         }
     }
 }
@@ -195,76 +266,255 @@ static StopId stopAreaFromStopPoint(StopId stopId) { return stopId - stopId % 10
 static bool isStopPoint(StopId stopId) { return stopId % 10000000000000 / 1000000000000 == 2; }
 
 Timetable::Timetable(const std::string& gtfsPath) {
-    for (const auto& t : gtfs::Trip::load(gtfsPath)) {
-        trips[t.tripId] = {t.serviceId, {}, t.directionId, t.routeId, t.shapeId};
-    }
-
-    for (const auto& st : gtfs::StopTime::load(gtfsPath)) {
-        StopId stopId = stopAreaFromStopPoint(st.stopId);
-        StopTime stopTime{st.tripId, st.arrivalTime.timestamp, st.departureTime.timestamp,
-                          stopId,    st.stopSequence,          st.shapeDistTravelled,
-                          st.stopId, st.stopHeadsign};
-
-        stopTimes[stopId].push_back(stopTime);
-        trips[st.tripId].stopTimes.push_back(stopTime);
-    }
-
-    for (auto& [stopId, st] : stopTimes) {
-        auto compare = [](const StopTime& a, const StopTime& b) { return a.departureTime < b.departureTime; };
-        std::sort(st.begin(), st.end(), compare);
-    }
-
-    for (auto& cd : gtfs::CalendarDate::load(gtfsPath)) {
-        calendarDates[cd.serviceId].insert(cd.date.original);
-        if (cd.date.original < startDate.original) startDate = {cd.date.original};
-        if (cd.date.original > endDate.original) endDate = {cd.date.original};
+    // Stop times as read from the file, until the trips and stops they refer to are known
+    struct StopTimeRow {
+        TripId tripId;
+        StopId stopPoint;
+        int32_t stopSequence;
+        int32_t arrivalTime;
+        int32_t departureTime;
+        StringId headsign;
+        double shapeDistTravelled;
+    };
+    std::vector<StopTimeRow> rows;
+    std::vector<gtfs::Trip> tripRows;
+    std::vector<gtfs::Stop> stopRows;
+    std::vector<gtfs::Transfer> transferRows;
+    std::vector<gtfs::Route> routeRows;
+
+    // The files do not depend on each other, so they are all parsed at the same time. Stop times take by far the
+    // longest. Their headsigns are interned while parsing, so no other task may use strings until all are done.
+    threadPool::parallelInvoke({
+        [&] {
+            bool loaded = gtfs::StopTime::forEach(gtfsPath, [this, &rows](gtfs::StopTime&& st) {
+                rows.push_back({st.tripId, st.stopId, st.stopSequence, st.arrivalTime.timestamp,
+                                st.departureTime.timestamp, strings.intern(st.stopHeadsign), st.shapeDistTravelled});
+            });
+            if (!loaded) throw std::runtime_error("Could not load the stop times of " + gtfsPath);
+        },
+        [&] { calendar = ServiceCalendar(gtfs::Calendar::load(gtfsPath), gtfs::CalendarDate::load(gtfsPath)); },
+        [&] { tripRows = gtfs::Trip::load(gtfsPath); },
+        [&] { stopRows = gtfs::Stop::load(gtfsPath); },
+        [&] { transferRows = gtfs::Transfer::load(gtfsPath); },
+        [&] { routeRows = gtfs::Route::load(gtfsPath); },
+        [&] {
+            bool loaded = gtfs::Shape::forEach(gtfsPath, [this](gtfs::Shape&& s) {
+                shapes.add(s.shapeId, s.shapeDistTravelled, s.shapePtLat, s.shapePtLon);
+            });
+            if (!loaded) throw std::runtime_error("Could not load the shapes of " + gtfsPath);
+            shapes.finish();
+        },
+        [&] {
+            auto feedInfos = gtfs::FeedInfo::load(gtfsPath);
+            if (feedInfos.empty()) throw std::runtime_error("No feed info in " + gtfsPath);
+            name = feedInfos[0].feedId + " " + feedInfos[0].feedVersion;
+        },
+    });
+
+    startDate = {calendar.firstDate};
+    endDate = {calendar.lastDate};
+
+    trips.push_back({});
+    for (const auto& t : tripRows) {
+        auto [it, inserted] = tripIndex.emplace(t.tripId, static_cast<TripIdx>(trips.size()));
+        if (inserted) trips.emplace_back();
+        trips[it->second] = {t.tripId, t.serviceId, calendar.pattern(t.serviceId), t.directionId, t.routeId, t.shapeId};
     }
 
-    for (auto& s : gtfs::Stop::load(gtfsPath)) {
+    for (auto& s : stopRows) {
         if (isStopPoint(s.stopId)) {
             stopPoints[s.stopId] = DMSCoord(s.stopLat, s.stopLon);
         } else {
-            stops[s.stopId] = StopNode(s.stopId, s.stopName, s.stopLat, s.stopLon);
+            StopNode& stop = stops[addStop(s.stopId)];
+            stop.name = strings.intern(s.stopName);
+            stop.lat = s.stopLat;
+            stop.lon = s.stopLon;
         }
     }
 
-    for (auto& t : gtfs::Transfer::load(gtfsPath)) {
-        StopId from = stopAreaFromStopPoint(t.fromStopId);
-        StopId to = stopAreaFromStopPoint(t.toStopId);
+    for (gtfs::Route& r : routeRows) {
+        routes[r.routeId] = {r.routeId, strings.intern(r.routeShortName), strings.intern(r.routeLongName), r.routeType};
+    }
+
+    // Trip and stop of every stop time. Stop times of trips missing from trips.txt could never be taken, as the trip
+    // has no service, and are dropped. The lookups are done in parallel, but stop areas that are only mentioned in
+    // stop_times.txt are added afterwards in file order, so that they are numbered the same on every load.
+    std::vector<TripIdx> rowTrips(rows.size());
+    std::vector<StopIdx> rowStops(rows.size());
+    size_t chunkSize = 1 << 16;
+    threadPool::parallelFor((rows.size() + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+        for (size_t r = chunk * chunkSize; r < std::min(rows.size(), (chunk + 1) * chunkSize); r++) {
+            auto trip = tripIndex.find(rows[r].tripId);
+            rowTrips[r] = trip == tripIndex.end() ? WALK : trip->second;
+            auto stop = stopIndex.find(stopAreaFromStopPoint(rows[r].stopPoint));
+            rowStops[r] = stop == stopIndex.end() ? NO_STOP : stop->second;
+        }
+    });
+    for (size_t r = 0; r < rows.size(); r++) {
+        if (rowTrips[r] == WALK || rowStops[r] != NO_STOP) continue;
+        rowStops[r] = addStop(stopAreaFromStopPoint(rows[r].stopPoint));
+    }
 
+    // Transfers are only added between stop areas that are already known. Others have no name or position, and no
+    // trip stops at them.
+    auto findStopArea = [this](StopId stopId) {
+        auto stop = stopIndex.find(isStopPoint(stopId) ? stopAreaFromStopPoint(stopId) : stopId);
+        return stop == stopIndex.end() ? NO_STOP : stop->second;
+    };
+    for (auto& t : transferRows) {
         if (t.transferType == 1) {
-            if (from != to) continue;
-            stops[from].transfersType1[t.fromTripId].push_back(t.toTripId);
+            StopIdx from = findStopArea(t.fromStopId);
+            if (from == NO_STOP || from != findStopArea(t.toStopId)) continue;
+            auto fromTrip = tripIndex.find(t.fromTripId);
+            auto toTrip = tripIndex.find(t.toTripId);
+            if (fromTrip == tripIndex.end() || toTrip == tripIndex.end()) continue;
+            stops[from].transfersType1[fromTrip->second].push_back(toTrip->second);
 
         } else if (t.transferType == 2) {
             // Set change margin for stop area
             if (t.fromStopId == t.toStopId && !isStopPoint(t.fromStopId) && t.minTransferTime) {
-                stops[t.fromStopId].minTransferTime = t.minTransferTime;
+                auto area = stopIndex.find(t.fromStopId);
+                if (area != stopIndex.end()) stops[area->second].minTransferTime = t.minTransferTime;
                 continue;
             }
 
-            if (from == to) continue;
+            StopIdx from = findStopArea(t.fromStopId);
+            StopIdx to = findStopArea(t.toStopId);
+            if (from == NO_STOP || to == NO_STOP || from == to) continue;
 
-            Edge transfer(&stops[to], t.minTransferTime, WALK, 0);
+            Edge transfer(to, t.minTransferTime, WALK, 0);
 
             auto& transfers = stops[from].transfersType2;
-            if (!std::any_of(transfers.begin(), transfers.end(), [to](auto t) { return t.to->stopId == to; })) {
+            if (!std::any_of(transfers.begin(), transfers.end(), [to](auto t) { return t.to == to; })) {
                 stops[from].transfersType2.push_back(transfer);
             }
         }
     }
 
-    for (gtfs::Route& r : gtfs::Route::load(gtfsPath)) {
-        routes[r.routeId] = r;
+    // Trip events, grouped by trip with a counting sort and then ordered by stop sequence within each trip
+    eventOffsets.assign(trips.size() + 1, 0);
+    for (size_t r = 0; r < rows.size(); r++) {
+        if (rowTrips[r] != WALK) eventOffsets[rowTrips[r] + 1]++;
+    }
+    for (size_t i = 1; i < eventOffsets.size(); i++) eventOffsets[i] += eventOffsets[i - 1];
+
+    std::vector<uint32_t> rowOfEvent(eventOffsets.back());
+    std::vector<uint32_t> next(eventOffsets.begin(), eventOffsets.end() - 1);
+    for (uint32_t r = 0; r < rows.size(); r++) {
+        if (rowTrips[r] != WALK) rowOfEvent[next[rowTrips[r]]++] = r;
     }
 
-    for (gtfs::Shape& s : gtfs::Shape::load(gtfsPath)) {
-        shapes[s.shapeId].emplace_back(s.shapeDistTravelled, DMSCoord(s.shapePtLat, s.shapePtLon));
+    events.resize(rowOfEvent.size());
+    eventShapeDistTravelled.resize(rowOfEvent.size());
+    eventStopPoints.resize(rowOfEvent.size());
+    eventHeadsigns.resize(rowOfEvent.size());
+    std::vector<int32_t> sequenceOfRow(rows.size());
+    size_t tripChunk = 1024;
+    threadPool::parallelFor((trips.size() + tripChunk - 1) / tripChunk, [&](size_t chunk) {
+        for (TripIdx trip = chunk * tripChunk; trip < std::min(trips.size(), (chunk + 1) * tripChunk); trip++) {
+            auto begin = rowOfEvent.begin() + eventOffsets[trip], end = rowOfEvent.begin() + eventOffsets[trip + 1];
+            std::stable_sort(begin, end, [&rows](uint32_t a, uint32_t b) {
+                return rows[a].stopSequence < rows[b].stopSequence;
+            });
+
+            for (uint32_t e = eventOffsets[trip]; e < eventOffsets[trip + 1]; e++) {
+                uint32_t r = rowOfEvent[e];
+                events[e] = {rows[r].arrivalTime, rows[r].departureTime, rowStops[r]};
+                eventShapeDistTravelled[e] = rows[r].shapeDistTravelled;
+                eventStopPoints[e] = rows[r].stopPoint;
+                eventHeadsigns[e] = rows[r].headsign;
+                sequenceOfRow[r] = static_cast<int32_t>(e - eventOffsets[trip] + 1);
+            }
+        }
+    });
+
+    // Departures, added in file order and then sorted by departure time within each stop
+    departureOffsets.assign(stops.size() + 1, 0);
+    for (uint32_t r : rowOfEvent) departureOffsets[rowStops[r] + 1]++;
+    for (size_t i = 1; i < departureOffsets.size(); i++) departureOffsets[i] += departureOffsets[i - 1];
+
+    departures.resize(rowOfEvent.size());
+    next.assign(departureOffsets.begin(), departureOffsets.end() - 1);
+    for (uint32_t r = 0; r < rows.size(); r++) {
+        if (rowTrips[r] == WALK) continue;
+        departures[next[rowStops[r]]++] = {rows[r].departureTime, rowTrips[r], sequenceOfRow[r]};
     }
+    size_t stopChunk = 256;
+    threadPool::parallelFor((stops.size() + stopChunk - 1) / stopChunk, [&](size_t chunk) {
+        for (StopIdx stop = chunk * stopChunk; stop < std::min(stops.size(), (chunk + 1) * stopChunk); stop++) {
+            auto compare = [](const Departure& a, const Departure& b) { return a.departureTime < b.departureTime; };
+            std::sort(departures.begin() + departureOffsets[stop], departures.begin() + departureOffsets[stop + 1],
+                      compare);
+        }
+    });
 
-    auto feedInfo = gtfs::FeedInfo::load(gtfsPath)[0];
-    feedInfo.feedVersion.pop_back();  // Remove '\r'
-    name = feedInfo.feedId + " " + feedInfo.feedVersion;
+    buildRoutePatterns();
+}
+
+StopIdx Timetable::addStop(StopId stopId) {
+    auto [it, inserted] = stopIndex.emplace(stopId, static_cast<StopIdx>(stops.size()));
+    if (inserted) stops.emplace_back(it->second, stopId, 0, 0.0f, 0.0f);
+    return it->second;
+}
+
+ActiveDepartures::ActiveDepartures(const Timetable& timetable, int32_t date)
+    : date(date), day(timetable.calendar.day(date)) {
+    patternOffsets.reserve(timetable.stops.size() + 1);
+    patternOffsets.push_back(0);
+    patternStarts.push_back(0);
+
+    // Group the running departures of each stop by shape, keeping them in departure order within a pattern
+    std::vector<std::pair<ShapeId, PatternDeparture>> byShape;
+    for (const StopNode& stop : timetable.stops) {
+        byShape.clear();
+        auto departures = day < 0 ? std::span<const Departure>{} : timetable.departuresFrom(stop.index);
+        for (uint32_t order = 0; order < departures.size(); order++) {
+            const Departure& departure = departures[order];
+            const Trip& trip = timetable.trips[departure.trip];
+            if (!timetable.calendar.runs(trip.calendar, day)) continue;
+            byShape.push_back({trip.shapeId, {departure.departureTime, departure.trip, departure.stopSequence, order}});
+        }
+        std::stable_sort(byShape.begin(), byShape.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        for (size_t i = 0; i < byShape.size(); i++) {
+            if (i > 0 && byShape[i].first != byShape[i - 1].first) {
+                patternStarts.push_back(static_cast<uint32_t>(patternDepartures.size()));
+            }
+            patternDepartures.push_back(byShape[i].second);
+        }
+        if (!byShape.empty()) patternStarts.push_back(static_cast<uint32_t>(patternDepartures.size()));
+        patternOffsets.push_back(static_cast<uint32_t>(patternStarts.size() - 1));
+    }
+    patternDepartures.shrink_to_fit();
+}
+
+std::shared_ptr<const ActiveDepartures> ActiveDeparturesCache::get(const Timetable& timetable, int32_t date) {
+    auto find = [&]() -> std::shared_ptr<const ActiveDepartures> {
+        auto it = std::find_if(entries.begin(), entries.end(), [date](const auto& e) { return e->date == date; });
+        if (it == entries.end()) return nullptr;
+        entries.splice(entries.begin(), entries, it);
+        return entries.front();
+    };
+
+    {
+        std::lock_guard lock(mutex);
+        if (auto cached = find()) return cached;
+    }
+
+    // Build without holding the lock so that other dates can be served meanwhile. If another thread built the same
+    // date in the meantime, use theirs and throw this one away.
+    auto built = std::make_shared<const ActiveDepartures>(timetable, date);
+
+    std::lock_guard lock(mutex);
+    if (auto cached = find()) return cached;
+    entries.push_front(built);
+    bytes += built->bytes();
+    while (bytes > limitBytes && entries.size() > 1) {
+        bytes -= entries.back()->bytes();
+        entries.pop_back();
+    }
+    return built;
 }
 
 std::string routing::prettyTravelTime(int32_t time) {
@@ -2,84 +2,148 @@
 
 #include <cstdint>
 #include <limits>
-#include <set>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "column.h"
 #include "gtfsTypes.h"
 #include "people.h"
+#include "serviceCalendar.h"
+#include "shapeStore.h"
+#include "stringPool.h"
 #undef max
 
+namespace csvLoader {
+class MappedFile;
+}
+
 namespace routing {
 
-const TripId WALK = 0;
+// Stops and trips are numbered 0, 1, 2... when the timetable is built, and routing uses these indices into the
+// timetable's vectors rather than hashing GTFS ids. Timetable::stopIndex and tripIndex translate GTFS ids to indices,
+// StopNode::stopId and Trip::tripId translate back.
+using StopIdx = uint32_t;
+using TripIdx = uint32_t;
+
+const StopIdx NO_STOP = std::numeric_limits<StopIdx>::max();
+
+// Trip index 0 is reserved for walking, trips[WALK] has no stop times
+const TripIdx WALK = 0;
+
+// Index into Timetable::routePatterns
+using PatternIdx = uint32_t;
+
+const PatternIdx NO_PATTERN = std::numeric_limits<PatternIdx>::max();
 
 struct DestinationEdge {
-    uint64_t destinationId;
+    StopIdx destination;
     int32_t cost;
 };
 
-class StopTime {
-   public:
-    TripId tripId;
-    int32_t arrivalTime;
+// A departure from a stop. Every stop has its departures sorted by departure time, see Timetable::departuresFrom.
+struct Departure {
     int32_t departureTime;
-    StopId stopId;
+    TripIdx trip;
     int32_t stopSequence;
-    double shapeDistTravelled;
-    StopId stopPoint;
-    std::string stopHeadsign;
-
-    explicit StopTime(int32_t departureTime) : departureTime(departureTime) {}
+};
 
-    StopTime(TripId tripId, int32_t arrivalTime, int32_t departureTime, StopId stopId, int32_t stopSequence,
-             double shapeDistTravelled, StopId stopPoint, std::string stopHeadsign)
-        : tripId(tripId),
-          arrivalTime(arrivalTime),
-          departureTime(departureTime),
-          stopId(stopId),
-          stopSequence(stopSequence),
-          shapeDistTravelled(shapeDistTravelled),
-          stopPoint(stopPoint),
-          stopHeadsign(std::move(stopHeadsign)) {}
+// A trip arriving at and leaving a stop. Event i of a trip has stop sequence i + 1, see Timetable::tripEvents.
+struct StopEvent {
+    int32_t arrivalTime;
+    int32_t departureTime;
+    StopIdx stop;
 };
 
+// Departures and events are scanned on every edge relaxation, so keep several of them in each cache line
+static_assert(sizeof(Departure) == 12 && sizeof(StopEvent) == 12);
+
 class StopNode;
 
 struct IncomingTrip {
-    StopNode* from{};
-    TripId tripId{};
+    StopIdx from{};
+    TripIdx trip{};
     int32_t stopSequence;
 
-    IncomingTrip(StopNode* from, TripId trip_id, int32_t stop_sequence)
-        : from(from), tripId(trip_id), stopSequence(stop_sequence) {}
+    IncomingTrip(StopIdx from, TripIdx trip, int32_t stop_sequence)
+        : from(from), trip(trip), stopSequence(stop_sequence) {}
 };
 
 struct Edge {
-    StopNode* to;
+    StopIdx to;
     int32_t cost;
-    TripId tripId;
+    TripIdx trip;
     int32_t stopSequence{};
 
-    Edge(StopNode* to, int32_t cost, TripId trip_id, int32_t stop_sequence)
-        : to(to), cost(cost), tripId(trip_id), stopSequence(stop_sequence) {}
+    Edge() = default;
+    Edge(StopIdx to, int32_t cost, TripIdx trip, int32_t stop_sequence)
+        : to(to), cost(cost), trip(trip), stopSequence(stop_sequence) {}
+};
+
+struct Route {
+    RouteId routeId;
+    StringId routeShortName;
+    StringId routeLongName;
+    int32_t routeType;
 };
 
 struct Trip {
+    TripId tripId;
     ServiceId serviceId;
-    std::vector<StopTime> stopTimes;
+    CalendarIdx calendar;  // see ServiceCalendar::pattern
     int32_t directionId;
     RouteId routeId;
     ShapeId shapeId;
+    PatternIdx pattern = NO_PATTERN;  // NO_PATTERN for WALK and trips without stop times
+};
+
+// Trips that call at the same stops in the same order and never overtake each other, for round based routing like
+// RAPTOR. The trips are sorted by departure, so they are also sorted by time at every stop of the pattern. The times
+// are stored stop by stop, see Timetable::patternTimesAt.
+struct RoutePattern {
+    uint32_t firstStop;  // into Timetable::patternStops
+    uint32_t firstTrip;  // into Timetable::patternTrips
+    uint32_t firstTime;  // into Timetable::patternTimes
+    uint32_t stopCount;
+    uint32_t tripCount;
+};
+
+struct PatternTime {
+    int32_t arrivalTime;
+    int32_t departureTime;
+};
+
+// A pattern calling at a stop, position is the index of the stop within the pattern
+struct PatternStop {
+    PatternIdx pattern;
+    uint32_t position;
 };
 
+// The departures of all trips from every stop but their last, sorted by time, for the Connection Scan Algorithm. Most
+// of them are only looked at for their time and stop, so the columns are kept apart. events are indices into
+// Timetable::tripEvents(trip).
+struct Connections {
+    std::vector<int32_t> departureTimes;
+    std::vector<StopIdx> stops;
+    std::vector<TripIdx> trips;
+    std::vector<uint32_t> events;
+};
+
+// The search Timetable::route runs. They give the same kind of result, but not always the same paths: dijkstra also
+// keeps alternative trips that arrive within the transfer time of the fastest one, RAPTOR and CSA only the fastest.
+enum class RoutingEngine { DIJKSTRA, RAPTOR, CSA };
+
 struct RoutingOptions {
     int32_t startTime;
     int32_t date;
     int32_t searchTime;
     int32_t minTransferTime;
     bool overrideMinTransferTime;
+    RoutingEngine engine = RoutingEngine::DIJKSTRA;
 
     RoutingOptions(int32_t start_time, int32_t date, int32_t search_time, int32_t min_transfer_time = 5 * 60,
                    bool override_min_transfer_time = false)
@@ -96,53 +160,272 @@ struct StopState {
     std::vector<IncomingTrip> incoming;
     bool visited = false;
     bool revisit = false;
+
+    // Stops that the search never got to keep the initial travel time
+    [[nodiscard]] bool reached() const { return travelTime != std::numeric_limits<int32_t>::max(); }
+};
+
+// How far Timetable::dijkstra has to search. It stops once every target is settled, or once maxTravelTime is passed.
+// The targets and the stops on the way to them are then as a full search leaves them, the stops it did not settle are
+// left unreached. No targets means all stops.
+struct SearchLimits {
+    std::vector<StopIdx> targets;
+    int32_t maxTravelTime = std::numeric_limits<int32_t>::max();
+};
+
+// Summed over searches, to see how much of the graph the limits of them spared
+struct SearchCounters {
+    uint64_t searches = 0;
+    uint64_t stoppedEarly = 0;
+    uint64_t settledStops = 0;
+    uint64_t prunedStops = 0;  // reached but not settled when a search stopped
+};
+
+// Leaving the start of a profile search at departureTime gets to a stop at arrivalTime, and leaving any later does not
+// get there as early, see Timetable::profile
+struct ProfileEntry {
+    int32_t departureTime;
+    int32_t arrivalTime;
+};
+
+class Timetable;
+
+// A departure in a pattern, see ActiveDepartures
+struct PatternDeparture {
+    int32_t departureTime;
+    TripIdx trip;
+    int32_t stopSequence;
+    uint32_t order;  // among all departures from the stop, which are in Timetable::departuresFrom order
+};
+
+// The departures of a single date, without the trips that do not run on it. The departures of every stop are grouped
+// into patterns, one per shape, that is per line and direction, so the next departure of each line is one binary search
+// away. The patterns of stop i are patternOffsets[i] up to patternOffsets[i + 1], and the departures of pattern p are
+// in pattern(p), sorted by departure time.
+struct ActiveDepartures {
+    int32_t date;
+    int32_t day;  // see ServiceCalendar::day, -1 if the feed has no service on the date
+
+    std::vector<uint32_t> patternOffsets;
+    std::vector<uint32_t> patternStarts;
+    std::vector<PatternDeparture> patternDepartures;
+
+    ActiveDepartures(const Timetable& timetable, int32_t date);
+
+    [[nodiscard]] std::span<const PatternDeparture> pattern(uint32_t p) const {
+        return {patternDepartures.data() + patternStarts[p], patternDepartures.data() + patternStarts[p + 1]};
+    }
+
+    [[nodiscard]] size_t bytes() const {
+        return (patternOffsets.size() + patternStarts.size()) * sizeof(uint32_t) +
+               patternDepartures.size() * sizeof(PatternDeparture);
+    }
+};
+
+// Active departures of the most recently used dates, shared by all threads. Dates are evicted least recently used
+// first when the cache holds more than limitBytes, but the date asked for last is always kept.
+class ActiveDeparturesCache {
+   public:
+    explicit ActiveDeparturesCache(size_t limitBytes = 256 << 20) : limitBytes(limitBytes) {}
+
+    // Builds the departures of date on the first call for it, the timetable must be the same on every call
+    std::shared_ptr<const ActiveDepartures> get(const Timetable& timetable, int32_t date);
+
+    size_t limitBytes;
+
+   private:
+    std::mutex mutex;
+    std::list<std::shared_ptr<const ActiveDepartures>> entries;  // most recently used first
+    size_t bytes = 0;
 };
 
 class Timetable {
    public:
-    std::unordered_map<StopId, StopNode> stops;
-    std::unordered_map<StopId, std::vector<StopTime>> stopTimes;
-    std::unordered_map<TripId, Trip> trips;
-    std::unordered_map<ServiceId, std::set<int32_t>> calendarDates;
-    std::unordered_map<RouteId, gtfs::Route> routes;
-    std::unordered_map<ShapeId, std::vector<std::pair<double, DMSCoord>>> shapes;
+    // Stop areas and trips, by index
+    std::vector<StopNode> stops;
+    std::vector<Trip> trips;
+
+    // The departures of stop i are departures[departureOffsets[i]] up to departures[departureOffsets[i + 1]]
+    Column<uint32_t> departureOffsets;
+    Column<Departure> departures;
+
+    // The events of trip i are events[eventOffsets[i]] up to events[eventOffsets[i + 1]]
+    Column<uint32_t> eventOffsets;
+    Column<StopEvent> events;
+
+    // Stop time columns that routing does not need, with the same index as events
+    Column<double> eventShapeDistTravelled;
+    Column<StopId> eventStopPoints;
+    Column<StringId> eventHeadsigns;
+
+    // Route patterns, every trip with stop times is in exactly one, see RoutePattern and Trip::pattern
+    Column<RoutePattern> routePatterns;
+    Column<StopIdx> patternStops;
+    Column<TripIdx> patternTrips;
+    Column<PatternTime> patternTimes;
+
+    // The patterns calling at stop i, see patternsAt
+    Column<uint32_t> stopPatternOffsets;
+    Column<PatternStop> stopPatterns;
+
+    std::unordered_map<StopId, StopIdx> stopIndex;
+    std::unordered_map<TripId, TripIdx> tripIndex;
+
+    ServiceCalendar calendar;
+    std::unordered_map<RouteId, Route> routes;
+    ShapeStore shapes;
     std::unordered_map<StopId, DMSCoord> stopPoints;
 
     gtfs::Date startDate = {std::numeric_limits<int32_t>::max()};
     gtfs::Date endDate = {0};
 
+    // Headsigns, stop names and route names, which are referred to by id
+    StringPool strings;
+
     std::string name;
 
     explicit Timetable(const std::string& gtfsPath);
 
-    std::unordered_map<StopId, StopState> dijkstra(StopId start, const RoutingOptions& options);
-    std::unordered_map<StopId, StopState> dijkstra(
-        StopId start, const RoutingOptions& options,
-        std::unordered_map<StopId, std::vector<DestinationEdge>>& destinationEdges);
+    // Loads the timetable from the snapshot data/caches/<feed file name>.tt if it was made from the same feed,
+    // otherwise builds it from the feed and saves a new snapshot for the next time
+    static std::unique_ptr<Timetable> load(const std::string& gtfsPath, const std::string& cacheDir = "data/caches");
+
+    // Writes the timetable to a binary snapshot file. feedChecksum is stored in it, see feedChecksum.
+    bool saveSnapshot(const std::string& path, uint64_t feedChecksum) const;
+
+    // Reads a snapshot written by saveSnapshot. Returns nullptr if the file is missing or broken, was written by
+    // another version of the program, or was made from a feed with another checksum.
+    static std::unique_ptr<Timetable> loadSnapshot(const std::string& path, uint64_t feedChecksum);
+
+    // Checksum of the contents of a GTFS directory or zip file
+    static uint64_t feedChecksum(const std::string& gtfsPath);
+
+    // Departures running on date, see ActiveDeparturesCache
+    std::shared_ptr<const ActiveDepartures> activeDepartures(int32_t date) const {
+        return departureCache.get(*this, date);
+    }
+
+    std::span<const Departure> departuresFrom(StopIdx stop) const {
+        return {departures.data() + departureOffsets[stop], departures.data() + departureOffsets[stop + 1]};
+    }
+
+    std::span<const StopEvent> tripEvents(TripIdx trip) const {
+        return {events.data() + eventOffsets[trip], events.data() + eventOffsets[trip + 1]};
+    }
+
+    std::span<const StopIdx> patternStopsOf(PatternIdx pattern) const {
+        const RoutePattern& p = routePatterns[pattern];
+        return {patternStops.data() + p.firstStop, p.stopCount};
+    }
+
+    std::span<const TripIdx> patternTripsOf(PatternIdx pattern) const {
+        const RoutePattern& p = routePatterns[pattern];
+        return {patternTrips.data() + p.firstTrip, p.tripCount};
+    }
+
+    // Times of all trips of a pattern at the stop with the given position in it, in the order of patternTripsOf
+    std::span<const PatternTime> patternTimesAt(PatternIdx pattern, uint32_t position) const {
+        const RoutePattern& p = routePatterns[pattern];
+        return {patternTimes.data() + p.firstTime + position * p.tripCount, p.tripCount};
+    }
+
+    std::span<const PatternStop> patternsAt(StopIdx stop) const {
+        return {stopPatterns.data() + stopPatternOffsets[stop], stopPatterns.data() + stopPatternOffsets[stop + 1]};
+    }
+
+    // Index into events and the event columns of the stop time with the given stop sequence
+    uint32_t eventIndex(TripIdx trip, int32_t stopSequence) const { return eventOffsets[trip] + stopSequence - 1; }
+
+    // The result has one state per stop, see StopState::reached
+    std::vector<StopState> dijkstra(StopIdx start, const RoutingOptions& options);
+    std::vector<StopState> dijkstra(StopIdx start, const RoutingOptions& options,
+                                    std::unordered_map<StopIdx, std::vector<DestinationEdge>>& destinationEdges,
+                                    const SearchLimits& limits = {}, SearchCounters* counters = nullptr);
+    std::vector<StopState> dijkstra(StopIdx start, const RoutingOptions& options, const SearchLimits& limits,
+                                    SearchCounters* counters = nullptr);
+
+    // Earliest arrival at every stop over the route patterns, in rounds of one more trip each. The incoming trips of a
+    // stop are the fastest way there first, and then the other trips passing it on the way to a stop further on.
+    std::vector<StopState> raptor(StopIdx start, const RoutingOptions& options);
+
+    // The earliest arrival at every stop for every time to leave start at from options.startTime up to window seconds
+    // later, with rRAPTOR: one raptor search per departure, latest first, each improving on the arrivals of the one
+    // before. The profile of a stop is sorted by departure, and both times only increase.
+    std::vector<std::vector<ProfileEntry>> profile(StopIdx start, const RoutingOptions& options, int32_t window);
+
+    // Earliest arrival at every stop with the Connection Scan Algorithm, in one pass over connections(). The result is
+    // like raptor's. With limits, the pass ends once the arrivals at the targets or within the bound can no longer
+    // improve, and stops that might still have are left unreached, like in dijkstra.
+    std::vector<StopState> connectionScan(StopIdx start, const RoutingOptions& options, const SearchLimits& limits = {},
+                                          SearchCounters* counters = nullptr);
+
+    // connectionScan from each of starts, in groups of eight that share one pass over the connections, so a group costs
+    // little more than a single search. limits is empty or has the limits of every start. The results are in the order
+    // of starts.
+    std::vector<std::vector<StopState>> connectionScan(std::span<const StopIdx> starts, const RoutingOptions& options,
+                                                       std::span<const SearchLimits> limits = {},
+                                                       SearchCounters* counters = nullptr);
+
+    // Every departure of every trip, sorted by time. Built on the first call, as only CSA needs them.
+    const Connections& connections() const;
+
+    // Runs the search picked by options.engine. Dijkstra and CSA stop early for the limits, raptor searches all stops.
+    std::vector<StopState> route(StopIdx start, const RoutingOptions& options);
+    std::vector<StopState> route(StopIdx start, const RoutingOptions& options, const SearchLimits& limits,
+                                 SearchCounters* counters = nullptr);
 
    private:
+    mutable ActiveDeparturesCache departureCache;
+
+    // A raptor search leaving start at departure, which only improves on the states it is given. Their travel times
+    // are from options.startTime.
+    void raptorSearch(StopIdx start, int32_t departure, const RoutingOptions& options, std::vector<StopState>& state);
+
+    // connectionScan from up to Lanes starts at once, limits is empty or has one entry per start
+    template <size_t Lanes>
+    std::vector<std::vector<StopState>> connectionScanLanes(std::span<const StopIdx> starts,
+                                                            const RoutingOptions& options,
+                                                            std::span<const SearchLimits> limits,
+                                                            SearchCounters* counters);
+
+    mutable std::once_flag connectionsBuilt;
+    mutable Connections connectionColumns;
+
+    // The snapshot the columns of a loaded timetable point into, see loadSnapshot
+    std::shared_ptr<const csvLoader::MappedFile> snapshotFile;
+
+    Timetable() = default;
     Timetable(const Timetable&);
+
+    StopIdx addStop(StopId stopId);
+
+    // Groups the trips into routePatterns, from the trip events
+    void buildRoutePatterns();
 };
 
 class StopNode {
    public:
+    StopIdx index{};
     StopId stopId{};
-    std::string name;
+    StringId name{};
     float lat{};
     float lon{};
-    std::unordered_map<TripId, std::vector<TripId>> transfersType1;
+    std::unordered_map<TripIdx, std::vector<TripIdx>> transfersType1;
     std::vector<Edge> transfersType2;
     int32_t minTransferTime = 5 * 60;
 
     StopNode() = default;
-    StopNode(StopId stop_id, std::string name, float lat, float lon)
-        : stopId(stop_id), name(std::move(name)), lat(lat), lon(lon) {}
+    StopNode(StopIdx index, StopId stop_id, StringId name, float lat, float lon)
+        : index(index), stopId(stop_id), name(name), lat(lat), lon(lon) {}
 
-    std::vector<Edge> getEdges(Timetable& timetable, const RoutingOptions& options, StopState* state, bool startNode);
+    // active must be the departures of options.date
+    std::vector<Edge> getEdges(Timetable& timetable, const ActiveDepartures& active, const RoutingOptions& options,
+                               StopState* state, bool startNode);
 
    private:
+    // day is options.date as a day number of the timetable's calendar, see ServiceCalendar::day
     void handleTransferType1(Timetable& timetable, const RoutingOptions& options, const StopState* state,
-                             std::vector<Edge>& outgoingEdges, TripId tripId);
+                             std::vector<Edge>& outgoingEdges, TripIdx fromTrip, int32_t day);
 };
 
 std::string prettyTravelTime(int32_t time);
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -18,6 +19,112 @@ const auto haha_it_broke = EXIT_FAILURE;
 namespace routingCacher {
 using namespace routing;
 
+// Runs dijkstra and another engine from every boarding statistics stop, and counts the stops where they arrive at
+// different times
+static void compareWithDijkstra(Timetable& timetable, RoutingOptions routingOptions, RoutingEngine engine,
+                                const std::string& name) {
+    RoutingOptions engineOptions = routingOptions;
+    engineOptions.engine = engine;
+
+    int64_t dijkstraDuration = 0, engineDuration = 0;
+    uint64_t same = 0, faster = 0, slower = 0, onlyDijkstra = 0, onlyEngine = 0;
+    for (const auto& [key, val] : boarding::getStats()) {
+        StopIdx start = timetable.stopIndex.at(key);
+
+        auto dijkstraStart = std::chrono::high_resolution_clock::now();
+        auto expected = timetable.dijkstra(start, routingOptions);
+        auto engineStart = std::chrono::high_resolution_clock::now();
+        auto result = timetable.route(start, engineOptions);
+        auto engineEnd = std::chrono::high_resolution_clock::now();
+        dijkstraDuration += duration_cast<std::chrono::microseconds>(engineStart - dijkstraStart).count();
+        engineDuration += duration_cast<std::chrono::microseconds>(engineEnd - engineStart).count();
+
+        for (StopIdx stop = 0; stop < expected.size(); stop++) {
+            if (!expected[stop].reached() || !result[stop].reached()) {
+                onlyDijkstra += expected[stop].reached() && !result[stop].reached();
+                onlyEngine += result[stop].reached() && !expected[stop].reached();
+            } else if (result[stop].travelTime == expected[stop].travelTime) {
+                same++;
+            } else if (result[stop].travelTime < expected[stop].travelTime) {
+                faster++;
+            } else {
+                slower++;
+            }
+        }
+    }
+
+    std::cout << "[TEST] [DIJKSTRA=" << dijkstraDuration / 1000 << "ms] [" << name << "=" << engineDuration / 1000
+              << "ms] [SAME=" << same << "] [" << name << " FASTER=" << faster << "] [" << name << " SLOWER=" << slower
+              << "] [ONLY DIJKSTRA=" << onlyDijkstra << "] [ONLY " << name << "=" << onlyEngine << "]" << std::endl;
+}
+
+// Checks that every entry of the profiles from the stops is what a raptor search leaving at its departure gives, and
+// times the profile against those searches
+static void compareProfileWithRaptor(Timetable& timetable, RoutingOptions routingOptions, int32_t window) {
+    int64_t profileDuration = 0, raptorDuration = 0;
+    uint64_t entries = 0, departures = 0, wrong = 0;
+    for (const auto& [key, val] : boarding::getStats()) {
+        StopIdx start = timetable.stopIndex.at(key);
+
+        auto profileStart = std::chrono::high_resolution_clock::now();
+        auto profiles = timetable.profile(start, routingOptions, window);
+        auto profileEnd = std::chrono::high_resolution_clock::now();
+        profileDuration += duration_cast<std::chrono::microseconds>(profileEnd - profileStart).count();
+
+        std::map<int32_t, std::vector<std::pair<StopIdx, int32_t>>> byDeparture;
+        for (StopIdx stop = 0; stop < profiles.size(); stop++) {
+            entries += profiles[stop].size();
+            for (const ProfileEntry& entry : profiles[stop]) {
+                byDeparture[entry.departureTime].emplace_back(stop, entry.arrivalTime);
+            }
+        }
+
+        for (const auto& [departure, arrivals] : byDeparture) {
+            RoutingOptions departureOptions = routingOptions;
+            departureOptions.startTime = departure;
+            auto raptorStart = std::chrono::high_resolution_clock::now();
+            auto result = timetable.raptor(start, departureOptions);
+            auto raptorEnd = std::chrono::high_resolution_clock::now();
+            raptorDuration += duration_cast<std::chrono::microseconds>(raptorEnd - raptorStart).count();
+
+            departures++;
+            for (const auto& [stop, arrival] : arrivals) {
+                if (!result[stop].reached() || departure + result[stop].travelTime != arrival) wrong++;
+            }
+        }
+    }
+
+    std::cout << "[TEST] [PROFILE=" << profileDuration / 1000 << "ms] [RAPTOR FOR EACH DEPARTURE="
+              << raptorDuration / 1000 << "ms] [DEPARTURES=" << departures << "] [ENTRIES=" << entries
+              << "] [WRONG=" << wrong << "]" << std::endl;
+}
+
+// Runs connectionScan from all boarding statistics stops at once and from each on its own, and counts the stops where
+// they arrive at different times
+static void compareBatchedScan(Timetable& timetable, const RoutingOptions& routingOptions) {
+    std::vector<StopIdx> starts;
+    for (const auto& [key, val] : boarding::getStats()) starts.push_back(timetable.stopIndex.at(key));
+
+    auto singleStart = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<StopState>> expected;
+    for (StopIdx start : starts) expected.push_back(timetable.connectionScan(start, routingOptions));
+    auto batchedStart = std::chrono::high_resolution_clock::now();
+    auto results = timetable.connectionScan(std::span<const StopIdx>(starts), routingOptions);
+    auto batchedEnd = std::chrono::high_resolution_clock::now();
+
+    uint64_t different = 0;
+    for (size_t i = 0; i < starts.size(); i++) {
+        for (StopIdx stop = 0; stop < expected[i].size(); stop++) {
+            different += results[i][stop].travelTime != expected[i][stop].travelTime;
+        }
+    }
+
+    auto singleDuration = duration_cast<std::chrono::milliseconds>(batchedStart - singleStart).count();
+    auto batchedDuration = duration_cast<std::chrono::milliseconds>(batchedEnd - batchedStart).count();
+    std::cout << "[TEST] [CSA ONE BY ONE=" << singleDuration << "ms] [CSA BATCHED=" << batchedDuration
+              << "ms] [STARTS=" << starts.size() << "] [DIFFERENT=" << different << "]" << std::endl;
+}
+
 /*
  * {
  *      stopId [string]: {
@@ -32,26 +139,30 @@ using namespace routing;
  * }
  */
 
-std::string toJson(std::unordered_map<StopId, StopState> map) {
+std::string toJson(const Timetable& timetable, const std::vector<StopState>& graph) {
     boost::json::object finalObj{};
-    finalObj.reserve(map.size());
 
-    std::for_each(map.begin(), map.end(), [&finalObj](const std::pair<StopId, StopState>& entry) {
+    for (StopIdx stop = 0; stop < graph.size(); stop++) {
+        const StopState& state = graph[stop];
+        if (!state.reached()) continue;
+
         std::vector<boost::json::value> incomingTrips;
-        incomingTrips.reserve(entry.second.incoming.size());
-
-        std::transform(entry.second.incoming.begin(), entry.second.incoming.end(), std::back_inserter(incomingTrips),
-                       [](IncomingTrip trip) {
-                           boost::json::value v = {{"from", trip.from->stopId},
-                                                   {"fromStr", std::to_string(trip.from->stopId)},
-                                                   {"trip", trip.tripId},
-                                                   {"tripStr", std::to_string(trip.tripId)}};
+        incomingTrips.reserve(state.incoming.size());
+
+        std::transform(state.incoming.begin(), state.incoming.end(), std::back_inserter(incomingTrips),
+                       [&timetable](IncomingTrip trip) {
+                           StopId from = timetable.stops[trip.from].stopId;
+                           TripId tripId = timetable.trips[trip.trip].tripId;
+                           boost::json::value v = {{"from", from},
+                                                   {"fromStr", std::to_string(from)},
+                                                   {"trip", tripId},
+                                                   {"tripStr", std::to_string(tripId)}};
                            return v;
                        });
 
-        boost::json::value val = {{"time", entry.second.travelTime}, {"incoming", incomingTrips}};
-        finalObj.emplace(std::to_string(entry.first), val);
-    });
+        boost::json::value val = {{"time", state.travelTime}, {"incoming", incomingTrips}};
+        finalObj.emplace(std::to_string(timetable.stops[stop].stopId), val);
+    }
 
     return serialize(finalObj);
 }
@@ -67,8 +178,8 @@ void printFile(const std::string& str, const std::string& path) {
     file.close();
 }
 
-void toFile(std::unordered_map<StopId, StopState> map, const std::string& path) {
-    printFile(toJson(std::move(map)), path);
+void toFile(const Timetable& timetable, const std::vector<StopState>& graph, const std::string& path) {
+    printFile(toJson(timetable, graph), path);
 }
 
 /* {
@@ -121,22 +232,24 @@ std::unordered_map<StopId, ParsedStopState> fromFile(const std::string& path) {
     return fromJson(str);
 }
 
-std::unordered_map<StopId, ParsedStopState> toPSS(std::unordered_map<StopId, StopState> map) {
+std::unordered_map<StopId, ParsedStopState> toPSS(const Timetable& timetable, const std::vector<StopState>& graph) {
     std::unordered_map<StopId, ParsedStopState> res;
-    res.reserve(map.size());
 
-    std::transform(map.begin(), map.end(), std::inserter(res, res.end()),
-                   [](const std::pair<StopId, StopState>& entry) {
-                       std::vector<ParsedIncomingTrip> incomingTrips;
-                       incomingTrips.reserve(entry.second.incoming.size());
+    for (StopIdx stop = 0; stop < graph.size(); stop++) {
+        const StopState& state = graph[stop];
+        if (!state.reached()) continue;
 
-                       std::transform(entry.second.incoming.begin(), entry.second.incoming.end(),
-                                      std::back_inserter(incomingTrips), [](IncomingTrip trip) {
-                                          return ParsedIncomingTrip{trip.from->stopId, trip.tripId};
-                                      });
+        std::vector<ParsedIncomingTrip> incomingTrips;
+        incomingTrips.reserve(state.incoming.size());
 
-                       return std::make_pair(entry.first, ParsedStopState{entry.second.travelTime, incomingTrips});
-                   });
+        std::transform(state.incoming.begin(), state.incoming.end(), std::back_inserter(incomingTrips),
+                       [&timetable](IncomingTrip trip) {
+                           return ParsedIncomingTrip{timetable.stops[trip.from].stopId,
+                                                     timetable.trips[trip.trip].tripId};
+                       });
+
+        res.emplace(timetable.stops[stop].stopId, ParsedStopState{state.travelTime, incomingTrips});
+    }
 
     return res;
 }
@@ -198,11 +311,11 @@ void test() {
         std::cout << "[TEST] testing id " << id << "...";
 
         auto start = std::chrono::high_resolution_clock::now();
-        auto result = timetable.dijkstra(9021014001360000, routingOptions);
+        auto result = timetable.dijkstra(timetable.stopIndex.at(9021014001360000), routingOptions);
         auto stopDijkstra = std::chrono::high_resolution_clock::now();
 
-        auto normalized_map = routingCacher::toPSS(result);
-        auto serialized = routingCacher::toJson(result);
+        auto normalized_map = routingCacher::toPSS(timetable, result);
+        auto serialized = routingCacher::toJson(timetable, result);
         auto reparsed = routingCacher::fromJson(serialized);
         auto stopFinal = std::chrono::high_resolution_clock::now();
 
@@ -223,8 +336,8 @@ void test() {
 
     auto djSt = std::chrono::high_resolution_clock::now();
     for (const auto& [key, val] : boarding::getStats()) {
-        auto result = timetable.dijkstra(key, routingOptions);
-        allResults.emplace(key, toJson(result));
+        auto result = timetable.dijkstra(timetable.stopIndex.at(key), routingOptions);
+        allResults.emplace(key, toJson(timetable, result));
     }
     auto djEnd = std::chrono::high_resolution_clock::now();
 
@@ -256,10 +369,10 @@ void test() {
     uint64_t totalDurGenerate = 0;
     for (int i = 0; i < runs; i++) {
         auto start = std::chrono::high_resolution_clock::now();
-        auto map = timetable.dijkstra(targetId, routingOptions);
+        auto graph = timetable.dijkstra(timetable.stopIndex.at(targetId), routingOptions);
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = duration_cast<std::chrono::microseconds>(end - start).count();
-        totalEntriesGenerate += map.size();
+        totalEntriesGenerate += std::count_if(graph.begin(), graph.end(), [](auto& s) { return s.reached(); });
         totalDurGenerate += duration;
     }
 
@@ -279,6 +392,14 @@ void test() {
     } else {
         std::cout << "[LOAD=" << entriesLoad << " ENTRIES] [GENERATE=" << entriesGenerate << " ENTRIES]" << std::endl;
     }
+
+    std::cout << "[TEST] Comparing the routing engines to dijkstra for the same stops" << std::endl;
+    compareWithDijkstra(timetable, routingOptions, RoutingEngine::RAPTOR, "RAPTOR");
+    compareWithDijkstra(timetable, routingOptions, RoutingEngine::CSA, "CSA");
+    compareBatchedScan(timetable, routingOptions);
+
+    std::cout << "[TEST] Comparing an hour of profiles to raptor for each departure" << std::endl;
+    compareProfileWithRaptor(timetable, routingOptions, 60 * 60);
 }
 
 bool ParsedIncomingTrip::operator==(const ParsedIncomingTrip& rhs) const {
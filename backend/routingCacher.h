@@ -45,11 +45,12 @@ struct ParsedStopState {
     bool operator!=(const ParsedStopState& rhs) const;
 };
 
-std::string toJson(std::unordered_map<StopId, StopState> map);
+// Stops and trips are written with their GTFS ids, only stops that were reached are included
+std::string toJson(const Timetable& timetable, const std::vector<StopState>& graph);
 
 std::unordered_map<StopId, ParsedStopState> fromJson(const std::string& json);
 
-std::unordered_map<StopId, ParsedStopState> toPSS(std::unordered_map<StopId, StopState> map);
+std::unordered_map<StopId, ParsedStopState> toPSS(const Timetable& timetable, const std::vector<StopState>& graph);
 
 void test();
 }  // namespace routingCacher
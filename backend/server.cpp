@@ -1,10 +1,14 @@
 #include <algorithm>
 #include <boost/json/src.hpp>
 #include <boost/url/src.hpp>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 #include "binarySearch.h"
 #include "boardingStatistics.h"
@@ -13,15 +17,26 @@
 #include "people.h"
 #include "routing.h"
 #include "routingCacher.h"
+#include "threadPool.h"
 #include "webServer/webServer.h"
 
 const auto address = net::ip::make_address("0.0.0.0");
 const auto port = static_cast<unsigned short>(8080);
 const auto doc_root = std::make_shared<std::string>(".");
 const auto threads = 4;
+const auto feedPollInterval = std::chrono::seconds(60);
 
+// Timetables are replaced as a whole when their feed changes. Requests copy the pointers they use, so they finish on
+// the version they started with while a new one is published. Ids are indices and stay the same across reloads.
+std::mutex timetablesMutex;
 std::vector<std::shared_ptr<routing::Timetable>> timetables;
 std::vector<std::shared_ptr<Prox>> proxes;
+std::vector<std::string> timetableFeeds;
+
+struct LoadedTimetable {
+    std::shared_ptr<routing::Timetable> timetable;
+    std::shared_ptr<Prox> prox;
+};
 
 using namespace boost::urls;
 
@@ -100,6 +115,13 @@ routing::RoutingOptions routingOptionsFromParams(const params_view& params) {
         options.searchTime = std::stoi((*params.find("searchTime")).value);
     }
 
+    // Which search to run, dijkstra unless another one is asked for
+    if (params.contains("engine")) {
+        std::string engine = (*params.find("engine")).value;
+        if (engine == "raptor") options.engine = routing::RoutingEngine::RAPTOR;
+        if (engine == "csa") options.engine = routing::RoutingEngine::CSA;
+    }
+
     if (params.contains("minTransferTime")) {
         int32_t minTransferTime = std::stoi((*params.find("minTransferTime")).value);
         if (minTransferTime >= 0) {
@@ -111,37 +133,143 @@ routing::RoutingOptions routingOptionsFromParams(const params_view& params) {
     return options;
 }
 
-int32_t timetableIdFromParams(const params_view& params) {
+LoadedTimetable timetableFromParams(const params_view& params) {
+    std::lock_guard lock(timetablesMutex);
     if (params.contains("timetable")) {
         int32_t id = std::stoi((*params.find("timetable")).value);
-        if (id >= 0 && id < timetables.size()) return id;
+        if (id >= 0 && id < timetables.size()) return {timetables[id], proxes[id]};
+    }
+    return {timetables.at(0), proxes.at(0)};
+}
+
+std::vector<std::string> listFeeds() {
+    std::vector<std::string> feeds;
+    std::error_code error;
+    for (const auto& gtfsEntry : std::filesystem::directory_iterator("data/gtfs", error)) {
+        // Feeds are either unpacked directories or .zip files, which are read without unpacking them
+        if (!gtfsEntry.is_directory() && gtfsEntry.path().extension() != ".zip") continue;
+        feeds.push_back(gtfsEntry.path().string());
+    }
+    return feeds;
+}
+
+// Sizes and modification times of the files of a feed, to notice changes without reading them
+uint64_t feedFingerprint(const std::string& feed) {
+    uint64_t fingerprint = 0;
+    auto add = [&fingerprint](const std::filesystem::path& path) {
+        std::error_code error;
+        auto size = std::filesystem::file_size(path, error);
+        auto modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        for (uint64_t value : {std::hash<std::string>{}(path.string()), uint64_t(size), uint64_t(modified)}) {
+            fingerprint = fingerprint * 1099511628211u ^ value;
+        }
+    };
+
+    std::error_code error;
+    if (std::filesystem::is_directory(feed, error)) {
+        for (const auto& entry : std::filesystem::directory_iterator(feed, error)) add(entry.path());
+    } else {
+        add(feed);
     }
-    return 0;
+    return fingerprint;
 }
 
-routing::Timetable& timetableFromParams(const params_view& params) {
-    return *timetables.at(timetableIdFromParams(params));
+// Builds the feed in the background and swaps it in, under the id it had before or a new one for a new feed
+void reloadFeed(const std::string& feed) {
+    std::cout << "Reloading timetable from " << feed << "..." << std::endl;
+    LoadedTimetable loaded;
+    try {
+        loaded.timetable = routing::Timetable::load(feed);
+        loaded.prox = std::make_shared<Prox>(*loaded.timetable);
+    } catch (const std::exception& e) {
+        std::cout << "Could not load " << feed << ", keeping the current version: " << e.what() << std::endl;
+        return;
+    }
+
+    std::lock_guard lock(timetablesMutex);
+    auto id = std::find(timetableFeeds.begin(), timetableFeeds.end(), feed) - timetableFeeds.begin();
+    if (id == timetableFeeds.size()) {
+        timetables.push_back(loaded.timetable);
+        proxes.push_back(loaded.prox);
+        timetableFeeds.push_back(feed);
+    } else {
+        timetables[id] = loaded.timetable;
+        proxes[id] = loaded.prox;
+    }
+    std::cout << loaded.timetable->name << " is loaded as timetable " << id << std::endl;
+}
+
+// Polls data/gtfs for new and changed feeds. A feed is only loaded once it looks the same on two polls in a row, so
+// one that is still being copied in is not picked up halfway. Removed feeds keep being served, to keep their ids.
+void watchFeeds(std::map<std::string, uint64_t> fingerprints) {
+    std::map<std::string, uint64_t> changed;
+    while (true) {
+        std::this_thread::sleep_for(feedPollInterval);
+        for (const auto& feed : listFeeds()) {
+            uint64_t fingerprint = feedFingerprint(feed);
+            auto known = fingerprints.find(feed);
+            if (known != fingerprints.end() && known->second == fingerprint) {
+                changed.erase(feed);
+                continue;
+            }
+
+            auto pending = changed.find(feed);
+            if (pending == changed.end() || pending->second != fingerprint) {
+                changed[feed] = fingerprint;
+                continue;
+            }
+            changed.erase(pending);
+            fingerprints[feed] = fingerprint;
+            reloadFeed(feed);
+        }
+    }
 }
 
 int main() {
     std::cout << "Starting server..." << std::endl;
     std::cout << "Loading timetables (1/7)" << std::endl;
 
-    for (const auto& gtfsEntry : std::filesystem::directory_iterator("data/gtfs")) {
-        if (!gtfsEntry.is_directory()) continue;
-
-        std::cout << "Loading timetable from " << gtfsEntry.path() << "..." << std::endl;
-        timetables.emplace_back(new routing::Timetable(gtfsEntry.path().string()));
-        std::cout << timetables.back()->name << " is loaded" << std::endl;
+    // Taken before loading, so that a feed which changes while the server starts is reloaded afterwards
+    std::vector<std::string> feeds = listFeeds();
+    std::map<std::string, uint64_t> fingerprints;
+    for (const auto& feed : feeds) fingerprints[feed] = feedFingerprint(feed);
+
+    // Feeds are loaded at the same time, each of them also parses its files in parallel. What was loaded is printed
+    // afterwards, in the order of the feeds, so that the lines of different feeds do not mix. A feed that cannot be
+    // loaded is left out, like in reloadFeed, and is tried again once it changes.
+    timetables.resize(feeds.size());
+    std::vector<std::string> errors(feeds.size());
+    for (const auto& feed : feeds) std::cout << "Loading timetable from " << feed << "..." << std::endl;
+    threadPool::parallelFor(feeds.size(), [&feeds, &errors](size_t i) {
+        try {
+            timetables[i] = routing::Timetable::load(feeds[i]);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    });
+    std::vector<size_t> order;
+    for (size_t i = 0; i < feeds.size(); i++) {
+        if (timetables[i]) {
+            std::cout << timetables[i]->name << " is loaded from " << feeds[i] << std::endl;
+            order.push_back(i);
+        } else {
+            std::cout << "Could not load " << feeds[i] << ", leaving it out: " << errors[i] << std::endl;
+        }
     }
 
-    // Order timetables by start date
-    std::sort(timetables.begin(), timetables.end(),
-              [](const auto& a, const auto& b) { return a->startDate.original > b->startDate.original; });
+    // Order timetables by start date. Feeds added later get the next free id instead, to not change existing ids.
+    std::sort(order.begin(), order.end(), [](size_t a, size_t b) {
+        return timetables[a]->startDate.original > timetables[b]->startDate.original;
+    });
+    for (size_t i : order) timetableFeeds.push_back(feeds[i]);
+    std::vector<std::shared_ptr<routing::Timetable>> loaded = std::move(timetables);
+    timetables.clear();
+    for (size_t i : order) timetables.push_back(loaded[i]);
 
     if (timetables.empty()) {
         std::cout << "No timetable found in data/gtfs, loading timetable from data/raw instead..." << std::endl;
-        timetables.emplace_back(new routing::Timetable("data/raw"));
+        timetables.emplace_back(routing::Timetable::load("data/raw"));
+        timetableFeeds.emplace_back("data/raw");
     }
 
     std::cout << "Loading lineregister (2/7)" << std::endl;
@@ -151,7 +279,10 @@ int main() {
     People people("data/raw/Ast_bost.txt");
 
     std::cout << "Loading prox (4/7)" << std::endl;
-    for (const auto& timetable : timetables) proxes.emplace_back(new Prox(*timetable));
+    proxes.resize(timetables.size());
+    threadPool::parallelFor(timetables.size(), [](size_t i) { proxes[i] = std::make_shared<Prox>(*timetables[i]); });
+
+    std::thread(watchFeeds, std::move(fingerprints)).detach();
 
     std::cout << "Loading boarding statistics (5/7)" << std::endl;
     boarding::load("data/raw/boarding_statistics.txt");
@@ -170,21 +301,61 @@ int main() {
 
         auto params = getParams(context.request);
         auto routingOptions = routingOptionsFromParams(params);
-        auto& timetable = timetableFromParams(params);
+        auto loaded = timetableFromParams(params);
+        auto& timetable = *loaded.timetable;
+
+        auto match = std::stoull(context.match[1].str());
+        auto result = timetable.route(timetable.stopIndex.at(match), routingOptions);
+        return routingCacher::toJson(timetable, result);
+    });
+
+    // The travel times for every time to leave the stop at in a window, by default two hours from time. Each stop gets
+    // its profile as [departure, arrival, departure, arrival, ...], in seconds after midnight and sorted by departure.
+    get((std::regex) "/profileFrom/(\\d+).*", [](auto context) {
+        context.response.set(http::field::content_type, "application/json");
+        context.response.set(http::field::access_control_allow_origin, "*");
+
+        auto params = getParams(context.request);
+        auto routingOptions = routingOptionsFromParams(params);
+        auto loaded = timetableFromParams(params);
+        auto& timetable = *loaded.timetable;
+
+        int32_t window = 2 * 60 * 60;
+        if (params.contains("window")) {
+            window = std::stoi((*params.find("window")).value);
+        }
 
         auto match = std::stoull(context.match[1].str());
-        auto result = timetable.dijkstra(match, routingOptions);
-        return routingCacher::toJson(result);
+        auto profiles = timetable.profile(timetable.stopIndex.at(match), routingOptions, window);
+
+        boost::json::object response;
+        for (routing::StopIdx stop = 0; stop < profiles.size(); stop++) {
+            if (profiles[stop].empty()) continue;
+            boost::json::array times;
+            times.reserve(profiles[stop].size() * 2);
+            for (const routing::ProfileEntry& entry : profiles[stop]) {
+                times.push_back(entry.departureTime);
+                times.push_back(entry.arrivalTime);
+            }
+            response.emplace(std::to_string(timetable.stops[stop].stopId), std::move(times));
+        }
+        return serialize(response);
     });
 
     get((std::regex) "/timetables", [](auto context) {
         context.response.set(http::field::content_type, "application/json");
         context.response.set(http::field::access_control_allow_origin, "*");
 
+        std::vector<std::shared_ptr<routing::Timetable>> current;
+        {
+            std::lock_guard lock(timetablesMutex);
+            current = timetables;
+        }
+
         std::vector<boost::json::value> tables;
 
-        for (size_t i = 0; i < timetables.size(); i++) {
-            auto& timetable = timetables[i];
+        for (size_t i = 0; i < current.size(); i++) {
+            auto& timetable = current[i];
             boost::json::value table = {
                 {"name", timetable->name},
                 {"id", i},
@@ -203,33 +374,34 @@ int main() {
 
         auto params = getParams(context.request);
         auto routingOptions = routingOptionsFromParams(params);
-        auto& timetable = timetableFromParams(params);
+        auto loaded = timetableFromParams(params);
+        auto& timetable = *loaded.timetable;
 
         auto match = std::stoull(context.match[1].str());
-        auto graph = timetable.dijkstra(match, routingOptions);
+        auto graph = timetable.route(timetable.stopIndex.at(match), routingOptions);
 
         std::vector<boost::json::value> stops;
-        std::transform(graph.begin(), graph.end(), std::back_inserter(stops),
-                       [&timetable](const std::pair<StopId, routing::StopState>& entry) {
-                           routing::StopState state = entry.second;
-                           routing::StopNode stop = timetable.stops[entry.first];
-
-                           boost::json::value feature = {
-                               {"type", "Feature"},
-                               {"id", stop.stopId},
-                               {"properties",
-                                {
-                                    {"name", stop.name},
-                                    {"travelTime", routing::prettyTravelTime(state.travelTime - state.initialWaitTime)},
-                                }},
-                               {"geometry",
-                                {
-                                    {"type", "Point"},
-                                    {"coordinates", {stop.lon, stop.lat}},
-                                }},
-                           };
-                           return feature;
-                       });
+        for (routing::StopIdx i = 0; i < graph.size(); i++) {
+            const routing::StopState& state = graph[i];
+            if (!state.reached()) continue;
+            const routing::StopNode& stop = timetable.stops[i];
+
+            boost::json::value feature = {
+                {"type", "Feature"},
+                {"id", stop.stopId},
+                {"properties",
+                 {
+                     {"name", std::string(timetable.strings[stop.name])},
+                     {"travelTime", routing::prettyTravelTime(state.travelTime - state.initialWaitTime)},
+                 }},
+                {"geometry",
+                 {
+                     {"type", "Point"},
+                     {"coordinates", {stop.lon, stop.lat}},
+                 }},
+            };
+            stops.push_back(feature);
+        }
         boost::json::value geoJson = {{"type", "FeatureCollection"}, {"features", stops}};
         return serialize(geoJson);
     });
@@ -239,15 +411,14 @@ int main() {
         context.response.set(http::field::access_control_allow_origin, "*");
 
         auto params = getParams(context.request);
-        auto& timetable = timetableFromParams(params);
+        auto loaded = timetableFromParams(params);
+        auto& timetable = *loaded.timetable;
 
         std::vector<boost::json::value> stops;
         std::transform(timetable.stops.begin(), timetable.stops.end(), std::back_inserter(stops),
-                       [](const std::pair<StopId, routing::StopNode>& entry) {
-                           routing::StopNode stop = entry.second;
-
-                           boost::json::object properties = {{"name", stop.name}};
-                           const std::string* icon = getStopIcon(entry.first);
+                       [&timetable](const routing::StopNode& stop) {
+                           boost::json::object properties = {{"name", std::string(timetable.strings[stop.name])}};
+                           const std::string* icon = getStopIcon(stop.stopId);
                            if (icon) properties["icon"] = *icon;
 
                            boost::json::value feature = {
@@ -273,18 +444,17 @@ int main() {
 
         auto params = getParams(context.request);
         auto routingOptions = routingOptionsFromParams(params);
-
-        int32_t timetableId = timetableIdFromParams(params);
-        auto& timetable = *timetables.at(timetableId);
+        auto loaded = timetableFromParams(params);
+        auto& timetable = *loaded.timetable;
 
         auto stopId = std::stoull(context.match[1].str());
-        auto& stop = timetable.stops.at(stopId);
+        auto& stop = timetable.stops[timetable.stopIndex.at(stopId)];
         auto stopCoord = DMSCoord(stop.lat, stop.lon);
 
         E2EE::Options options = {
-            stopId, 0.6, 500, 500, 500, E2EE::COLLECT_ALL & (~E2EE::COLLECT_EXTRACTED_PATHS), routingOptions};
+            stop.index, 0.6, 500, 500, 500, E2EE::COLLECT_ALL & (~E2EE::COLLECT_EXTRACTED_PATHS), routingOptions};
 
-        E2EE endToEndEval(people, timetable, *proxes.at(timetableId));
+        E2EE endToEndEval(people, timetable, *loaded.prox);
         E2EE::Stats stats = endToEndEval.evaluatePerformanceAtPoint(stopCoord.toMeter(), options);
 
         uint32_t medianTravelTime = 0;
@@ -347,22 +517,23 @@ int main() {
         std::vector<boost::json::value> segments;
         std::vector<boost::json::value> walks;
 
-        std::vector<std::pair<StopId, float>> sortedTransfers;
-        for (const auto& [transferStopId, count] : stats.transfers) {
+        std::vector<std::pair<routing::StopIdx, float>> sortedTransfers;
+        for (const auto& [transferStop, count] : stats.transfers) {
             float percentage = (float)count / (float)stats.allPaths.size() * 100.0f;
             if (count <= 1 || percentage < 1) continue;
-            sortedTransfers.emplace_back(transferStopId, percentage);
+            sortedTransfers.emplace_back(transferStop, percentage);
         }
         std::sort(sortedTransfers.begin(), sortedTransfers.end(), [](auto& a, auto& b) { return a.second > b.second; });
 
         std::vector<boost::json::value> transfers;
         std::transform(sortedTransfers.begin(), sortedTransfers.end(), std::back_inserter(transfers),
                        [&timetable](auto& pair) {
-                           auto [stopID, percentage] = pair;
-                           auto& name = timetable.stops.at(stopID).name;
+                           auto [stopIdx, percentage] = pair;
+                           auto& stop = timetable.stops[stopIdx];
+                           std::string name(timetable.strings[stop.name]);
 
                            return boost::json::value{
-                               {"stopID", std::to_string(stopID)}, {"stopName", name}, {"percentage", percentage}};
+                               {"stopID", std::to_string(stop.stopId)}, {"stopName", name}, {"percentage", percentage}};
                        });
 
         for (const auto& [segmentId, segment] : stats.shapeSegments) {
@@ -371,12 +542,12 @@ int main() {
             std::vector<boost::json::value> lineString;
 
             boost::json::object properties = {
-                {"from", segment.startStop},
-                {"to", segment.endStop},
+                {"from", timetable.stops[segment.startStop].stopId},
+                {"to", timetable.stops[segment.endStop].stopId},
                 {"passengerCount", segment.passengerCount},
             };
 
-            if (segment.tripId == routing::WALK) {
+            if (segment.trip == routing::WALK) {
                 auto& start = timetable.stops[segment.startStop];
                 auto& end = timetable.stops[segment.endStop];
                 lineString = {{start.lon, start.lat}, {end.lon, end.lat}};
@@ -389,20 +560,21 @@ int main() {
 
                 walks.push_back(feature);
             } else {
-                routing::Trip& trip = timetable.trips[segment.tripId];
-                gtfs::Route& route = timetable.routes[trip.routeId];
+                routing::Trip& trip = timetable.trips[segment.trip];
+                routing::Route& route = timetable.routes[trip.routeId];
 
-                properties["routeName"] = route.routeShortName;
-                properties["headsign"] = trip.stopTimes.at(segment.stopSequence - 1).stopHeadsign;
+                properties["routeName"] = std::string(timetable.strings[route.routeShortName]);
+                uint32_t event = timetable.eventIndex(segment.trip, segment.stopSequence);
+                properties["headsign"] = std::string(timetable.strings[timetable.eventHeadsigns.at(event)]);
 
                 auto& line = lineRegister.lines[trip.routeId];
                 properties["fgColor"] = line.fgColor;
                 properties["bgColor"] = line.bgColor;
 
-                auto& shape = timetable.shapes[trip.shapeId];
+                auto shape = timetable.shapes.points(trip.shapeId);
 
-                auto start = &shape[segment.startIdx];
-                auto end = &shape[segment.endIdx];
+                auto start = shape.begin() + segment.startIdx;
+                auto end = shape.begin() + segment.endIdx;
 
                 std::transform(start, end, std::back_inserter(lineString),
                                [](const std::pair<double, DMSCoord>& point) {
@@ -423,19 +595,19 @@ int main() {
         boost::json::value linesGeoJson = {{"type", "FeatureCollection"}, {"features", segments}};
         boost::json::value walksGeoJson = {{"type", "FeatureCollection"}, {"features", walks}};
 
-        std::vector<std::pair<StopId, int>> sortedPpl;
+        std::vector<std::pair<routing::StopIdx, int>> sortedPpl;
         for (auto& a : stats.optimalFirstStop) sortedPpl.emplace_back(a);
         std::sort(sortedPpl.begin(), sortedPpl.end(), [](auto a, auto b) { return a.second > b.second; });
 
         std::vector<boost::json::value> pplTravelFrom;
 
         std::transform(sortedPpl.begin(), sortedPpl.end(), std::back_inserter(pplTravelFrom), [&timetable](auto pair) {
-            auto [stopID, numberOfPeople] = pair;
-            auto name = timetable.stops.contains(stopID) ? (timetable.stops.at(stopID).name)
-                                                         : "[ID:" + std::to_string(stopID) + "]";
+            auto [stopIdx, numberOfPeople] = pair;
+            auto& stop = timetable.stops.at(stopIdx);
+            std::string name(timetable.strings[stop.name]);
 
             return boost::json::value{
-                {"stopID", std::to_string(stopID)}, {"stopName", name}, {"numberOfPersons", numberOfPeople}};
+                {"stopID", std::to_string(stop.stopId)}, {"stopName", name}, {"numberOfPersons", numberOfPeople}};
         });
 
         double avgStopsFrom = 0;
@@ -482,7 +654,7 @@ int main() {
             {"totalNrPeople", stats.personsWithinRange},
             {"peopleCanGoByBus", stats.personsCanGoWithBus},
             {"optimalNrPeople", stats.hasThisAsOptimal},
-            {"interestingStopID", std::to_string(stats.interestingStop)},
+            {"interestingStopID", std::to_string(timetable.stops[stats.interestingStop].stopId)},
             {"medianTravelTime", medianTravelTime},
             {"medianTravelTimeFormatted", medianTravelTimeFormatted},
             {"avgWaitTime", avgWaitTime},
@@ -514,10 +686,11 @@ int main() {
         context.response.set(http::field::content_type, "application/json");
 
         auto params = getParams(context.request);
-        auto& timetable = timetableFromParams(params);
+        auto loaded = timetableFromParams(params);
+        auto& timetable = *loaded.timetable;
 
         auto stopId = std::stoull(context.match[1].str());
-        auto& stop = timetable.stops.at(stopId);
+        auto& stop = timetable.stops[timetable.stopIndex.at(stopId)];
         auto stopCoord = DMSCoord(stop.lat, stop.lon);
 
         // Find every person that lives close (500 meter) to this given stop
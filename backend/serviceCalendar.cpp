@@ -0,0 +1,112 @@
+#include "serviceCalendar.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <map>
+
+namespace chrono = std::chrono;
+
+int32_t ServiceCalendar::daysSinceEpoch(int32_t date) {
+    chrono::year_month_day ymd{chrono::year{date / 10000}, chrono::month{static_cast<unsigned>(date / 100 % 100)},
+                               chrono::day{static_cast<unsigned>(date % 100)}};
+    if (!ymd.ok()) return std::numeric_limits<int32_t>::min();
+    return static_cast<int32_t>(chrono::sys_days{ymd}.time_since_epoch().count());
+}
+
+ServiceCalendar::ServiceCalendar(const std::vector<gtfs::Calendar>& calendars,
+                                 const std::vector<gtfs::CalendarDate>& calendarDates) {
+    int32_t first = std::numeric_limits<int32_t>::max();
+    int32_t last = std::numeric_limits<int32_t>::min();
+    auto include = [&](int32_t date) {
+        int32_t d = daysSinceEpoch(date);
+        if (d == std::numeric_limits<int32_t>::min()) return;
+        first = std::min(first, d);
+        last = std::max(last, d);
+    };
+    for (const auto& c : calendars) {
+        include(c.startDate.original);
+        include(c.endDate.original);
+    }
+    for (const auto& cd : calendarDates) include(cd.date.original);
+
+    // Pattern 0 is the empty one, for services without any days
+    if (first > last) {
+        wordsPerPattern = 1;
+        bits.assign(1, 0);
+        return;
+    }
+    firstDay = first;
+    days = last - first + 1;
+    wordsPerPattern = (days + 63) / 64;
+
+    std::unordered_map<ServiceId, std::vector<uint64_t>> serviceBits;
+    auto set = [&](ServiceId service, int32_t day, bool runs) {
+        auto& words = serviceBits.try_emplace(service, wordsPerPattern, 0).first->second;
+        if (runs) {
+            words[day / 64] |= uint64_t{1} << (day % 64);
+        } else {
+            words[day / 64] &= ~(uint64_t{1} << (day % 64));
+        }
+    };
+
+    for (const auto& c : calendars) {
+        serviceBits.try_emplace(c.serviceId, wordsPerPattern, 0);
+        int32_t start = daysSinceEpoch(c.startDate.original);
+        int32_t end = daysSinceEpoch(c.endDate.original);
+        if (start == std::numeric_limits<int32_t>::min() || end == std::numeric_limits<int32_t>::min()) continue;
+
+        // Weekdays as numbered by std::chrono::weekday, Sunday first
+        const bool weekdays[] = {c.sunday, c.monday, c.tuesday, c.wednesday, c.thursday, c.friday, c.saturday};
+        for (int32_t d = start; d <= end; d++) {
+            unsigned weekday = chrono::weekday{chrono::sys_days{chrono::days{d}}}.c_encoding();
+            if (weekdays[weekday]) set(c.serviceId, d - firstDay, true);
+        }
+    }
+
+    // Exception type 1 adds the date to the service, 2 removes it
+    for (const auto& cd : calendarDates) {
+        int32_t d = daysSinceEpoch(cd.date.original);
+        if (d == std::numeric_limits<int32_t>::min()) continue;
+        if (cd.exceptionType == 1 || cd.exceptionType == 2) set(cd.serviceId, d - firstDay, cd.exceptionType == 1);
+    }
+
+    std::map<std::vector<uint64_t>, CalendarIdx> distinct;
+    distinct.emplace(std::vector<uint64_t>(wordsPerPattern, 0), 0);
+    bits.assign(wordsPerPattern, 0);
+    for (const auto& [service, words] : serviceBits) {
+        auto [it, inserted] = distinct.emplace(words, static_cast<CalendarIdx>(distinct.size()));
+        if (inserted) bits.insert(bits.end(), words.begin(), words.end());
+        patterns.emplace(service, it->second);
+    }
+
+    // Narrow the reported range to the days that have any service at all
+    std::vector<uint64_t> any(wordsPerPattern, 0);
+    for (size_t i = 0; i < bits.size(); i++) any[i % wordsPerPattern] |= bits[i];
+    int32_t firstRunning = -1, lastRunning = -1;
+    for (int32_t d = 0; d < days; d++) {
+        if (!(any[d / 64] >> (d % 64) & 1)) continue;
+        if (firstRunning < 0) firstRunning = d;
+        lastRunning = d;
+    }
+    if (firstRunning < 0) return;
+
+    auto toDate = [&](int32_t d) {
+        chrono::year_month_day ymd{chrono::sys_days{chrono::days{firstDay + d}}};
+        return static_cast<int32_t>(ymd.year()) * 10000 + static_cast<int32_t>(unsigned{ymd.month()}) * 100 +
+               static_cast<int32_t>(unsigned{ymd.day()});
+    };
+    firstDate = toDate(firstRunning);
+    lastDate = toDate(lastRunning);
+}
+
+int32_t ServiceCalendar::day(int32_t date) const {
+    int32_t d = daysSinceEpoch(date);
+    if (d == std::numeric_limits<int32_t>::min() || d < firstDay || d >= firstDay + days) return -1;
+    return d - firstDay;
+}
+
+CalendarIdx ServiceCalendar::pattern(ServiceId service) const {
+    auto it = patterns.find(service);
+    return it == patterns.end() ? 0 : it->second;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "gtfsTypes.h"
+
+using CalendarIdx = uint32_t;
+
+// The days each service runs, as a bitset over the days from the first to the last date in the feed. Services that run
+// on exactly the same days share one bitset, a pattern, and trips keep the index of their pattern so that checking if a
+// departure runs on a day is a single bit test. Pattern 0 never runs.
+class ServiceCalendar {
+   public:
+    ServiceCalendar() = default;
+
+    // Uses the weekdays and date range of calendar.txt, then adds and removes the dates in calendar_dates.txt
+    ServiceCalendar(const std::vector<gtfs::Calendar>& calendars, const std::vector<gtfs::CalendarDate>& calendarDates);
+
+    // Day number of a YYYYMMDD date in the calendar, or -1 if it is outside the feed
+    [[nodiscard]] int32_t day(int32_t date) const;
+
+    // Whether a pattern runs on a day number returned by day(), which must not be -1
+    [[nodiscard]] bool runs(CalendarIdx pattern, int32_t day) const {
+        return bits[pattern * wordsPerPattern + day / 64] >> (day % 64) & 1;
+    }
+
+    // Pattern of a service, services which are not in the calendar never run
+    [[nodiscard]] CalendarIdx pattern(ServiceId service) const;
+
+    [[nodiscard]] size_t patternCount() const { return wordsPerPattern == 0 ? 0 : bits.size() / wordsPerPattern; }
+
+    // First and last date with any service as YYYYMMDD, both 0 if the calendar is empty
+    int32_t firstDate = 0;
+    int32_t lastDate = 0;
+
+    int32_t firstDay = 0;  // days since 1970-01-01
+    int32_t days = 0;
+    uint32_t wordsPerPattern = 0;
+    std::vector<uint64_t> bits;
+    std::unordered_map<ServiceId, CalendarIdx> patterns;
+
+    // Days since 1970-01-01 of a YYYYMMDD date, or INT32_MIN if it is not a valid date
+    static int32_t daysSinceEpoch(int32_t date);
+};
@@ -0,0 +1,79 @@
+#include "shapeStore.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double degreeScale = 1e6;
+constexpr double distanceScale = 100;
+
+int32_t quantize(double value, double scale) { return static_cast<int32_t>(std::lround(value * scale)); }
+
+// Zigzag LEB128, small deltas of either sign take one or two bytes
+void putDelta(std::vector<uint8_t>& out, int32_t delta) {
+    auto v = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+int32_t getDelta(const uint8_t*& in) {
+    uint32_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *in++;
+        v |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+}  // namespace
+
+void ShapeStore::add(ShapeId shape, double distance, double latitude, double longitude) {
+    pending.push_back({shape, quantize(distance, distanceScale), quantize(latitude, degreeScale),
+                       quantize(longitude, degreeScale)});
+}
+
+void ShapeStore::finish() {
+    std::stable_sort(pending.begin(), pending.end(), [](const auto& a, const auto& b) { return a.shape < b.shape; });
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        const PendingPoint& p = pending[i];
+        bool first = i == 0 || pending[i - 1].shape != p.shape;
+        if (first) {
+            if (!ids.empty()) offsets.push_back(static_cast<uint32_t>(data.size()));
+            ids.push_back(p.shape);
+        }
+        const PendingPoint previous = first ? PendingPoint{} : pending[i - 1];
+        putDelta(data, p.distance - previous.distance);
+        putDelta(data, p.latitude - previous.latitude);
+        putDelta(data, p.longitude - previous.longitude);
+    }
+    if (!ids.empty()) offsets.push_back(static_cast<uint32_t>(data.size()));
+
+    pending.clear();
+    pending.shrink_to_fit();
+}
+
+std::vector<ShapeStore::Point> ShapeStore::points(ShapeId shape) const {
+    std::vector<Point> result;
+    auto it = std::lower_bound(ids.begin(), ids.end(), shape);
+    if (it == ids.end() || *it != shape) return result;
+
+    size_t i = it - ids.begin();
+    const uint8_t* in = data.data() + offsets[i];
+    const uint8_t* end = data.data() + offsets[i + 1];
+    int32_t distance = 0, latitude = 0, longitude = 0;
+    while (in < end) {
+        distance += getDelta(in);
+        latitude += getDelta(in);
+        longitude += getDelta(in);
+        result.emplace_back(distance / distanceScale, DMSCoord(latitude / degreeScale, longitude / degreeScale));
+    }
+    return result;
+}
+
+double ShapeStore::roundDistance(double distance) { return quantize(distance, distanceScale) / distanceScale; }
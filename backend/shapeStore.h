@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gtfsTypes.h"
+#include "people.h"
+
+// The points of all shapes, kept as delta encoded variable length integers and only decoded when a shape is asked for.
+// Coordinates are stored in microdegrees and distances in centimetres, so a point usually takes 3-6 bytes instead of
+// the 24 of a decoded one.
+class ShapeStore {
+   public:
+    using Point = std::pair<double, DMSCoord>;
+
+    // Adds a point to the end of a shape. Shapes may be added interleaved, finish() must be called after the last one.
+    void add(ShapeId shape, double distance, double latitude, double longitude);
+
+    void finish();
+
+    // Decoded points of a shape in the order they were added, empty if there is no such shape
+    [[nodiscard]] std::vector<Point> points(ShapeId shape) const;
+
+    [[nodiscard]] size_t size() const { return ids.size(); }
+
+    // A distance with the precision that is stored, to compare with the distances of decoded points
+    static double roundDistance(double distance);
+
+    // Shape ids in increasing order, and the bytes of shape i between offsets[i] and offsets[i + 1] of data
+    std::vector<ShapeId> ids;
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint8_t> data;
+
+   private:
+    struct PendingPoint {
+        ShapeId shape;
+        int32_t distance, latitude, longitude;
+    };
+    std::vector<PendingPoint> pending;
+};
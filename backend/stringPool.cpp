@@ -0,0 +1,38 @@
+#include "stringPool.h"
+
+#include <cstring>
+#include <stdexcept>
+
+StringPool::StringPool() {
+    strings.emplace_back();
+    ids.emplace(std::string_view{}, 0);
+}
+
+StringId StringPool::intern(std::string_view str) {
+    auto it = ids.find(str);
+    if (it != ids.end()) return it->second;
+
+    if (strings.size() > UINT32_MAX) throw std::length_error("StringPool is full");
+
+    // Strings longer than a block get a block of their own, and the current block is kept filling up afterwards
+    char* dest;
+    if (str.size() > blockSize) {
+        dest = blocks.emplace_back(new char[str.size()]).get();
+    } else {
+        if (blockUsed + str.size() > blockSize) {
+            block = blocks.emplace_back(new char[blockSize]).get();
+            blockUsed = 0;
+        }
+        dest = block + blockUsed;
+        blockUsed += str.size();
+    }
+
+    std::memcpy(dest, str.data(), str.size());
+    totalBytes += str.size();
+
+    auto id = static_cast<StringId>(strings.size());
+    std::string_view stored(dest, str.size());
+    strings.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using StringId = uint32_t;
+
+// Stores every distinct string once and hands out 32 bit ids for them, for text columns like headsigns and stop names
+// which repeat across millions of rows. Id 0 is always the empty string. The characters are kept in blocks which never
+// move, so the views handed out stay valid for as long as the pool lives. Not thread safe.
+class StringPool {
+   public:
+    StringPool();
+
+    StringPool(StringPool&&) = default;
+    StringPool& operator=(StringPool&&) = default;
+
+    // Returns the id of str, adding it to the pool if it is not there yet
+    StringId intern(std::string_view str);
+
+    [[nodiscard]] std::string_view operator[](StringId id) const { return strings[id]; }
+
+    // Number of distinct strings, including the empty string
+    [[nodiscard]] size_t size() const { return strings.size(); }
+
+    // Bytes of character data held by the pool
+    [[nodiscard]] size_t bytes() const { return totalBytes; }
+
+   private:
+    static constexpr size_t blockSize = 64 << 10;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* block = nullptr;
+    size_t blockUsed = blockSize;
+    size_t totalBytes = 0;
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, StringId> ids;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <string_view>
+
+// Shared by the synthetic feed and population generators
+namespace synthetic {
+
+// SplitMix64. The standard distributions are implementation defined, so they would give different data with different
+// standard libraries.
+class Random {
+   public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n)
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>((next() >> 32) * n >> 32); }
+
+    // Uniform in [lo, hi]
+    int32_t between(int32_t lo, int32_t hi) { return lo + static_cast<int32_t>(below(hi - lo + 1)); }
+
+    // Uniform in [0, 1)
+    double real() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    bool chance(double p) { return real() < p; }
+
+    // Standard normal, by the Box-Muller transform
+    double normal() {
+        double u = 1 - real();
+        return std::sqrt(-2 * std::log(u)) * std::cos(2 * std::numbers::pi * real());
+    }
+
+   private:
+    uint64_t state;
+};
+
+// Buffered CSV output. Fields never contain delimiters or quotes, so nothing is quoted.
+class CsvWriter {
+   public:
+    CsvWriter(const std::filesystem::path& path, std::string_view header)
+        : file(std::fopen(path.string().c_str(), "wb")) {
+        if (!file) {
+            std::cerr << "[ERROR!] Could not open " << path << " for writing" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        buffer.reserve(bufferSize + 256);
+        buffer.append(header);
+        buffer.push_back('\n');
+    }
+
+    ~CsvWriter() {
+        flush();
+        std::fclose(file);
+    }
+
+    CsvWriter& operator<<(std::string_view str) {
+        separate();
+        buffer.append(str);
+        return *this;
+    }
+
+    CsvWriter& operator<<(uint64_t value) { return number(value); }
+    CsvWriter& operator<<(int32_t value) { return number(value); }
+
+    // Fixed point with the given number of decimals
+    CsvWriter& fixed(double value, int decimals) {
+        separate();
+        char tmp[64];
+        auto result = std::to_chars(tmp, tmp + sizeof tmp, value, std::chars_format::fixed, decimals);
+        buffer.append(tmp, result.ptr);
+        return *this;
+    }
+
+    // Seconds after midnight as HH:MM:SS, where HH may go past 24
+    CsvWriter& time(int32_t seconds) {
+        separate();
+        char tmp[16];
+        std::snprintf(tmp, sizeof tmp, "%02d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+        buffer.append(tmp);
+        return *this;
+    }
+
+    // An empty field
+    CsvWriter& empty() { return *this << std::string_view{}; }
+
+    void endRow() {
+        buffer.push_back('\n');
+        first = true;
+        if (buffer.size() >= bufferSize) flush();
+    }
+
+   private:
+    static constexpr size_t bufferSize = 1 << 20;
+
+    template <typename T>
+    CsvWriter& number(T value) {
+        separate();
+        char tmp[24];
+        auto result = std::to_chars(tmp, tmp + sizeof tmp, value);
+        buffer.append(tmp, result.ptr);
+        return *this;
+    }
+
+    void separate() {
+        if (!first) buffer.push_back(',');
+        first = false;
+    }
+
+    void flush() {
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+
+    std::FILE* file;
+    std::string buffer;
+    bool first = true;
+};
+}  // namespace synthetic
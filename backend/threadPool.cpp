@@ -0,0 +1,121 @@
+#include "threadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace threadPool {
+
+namespace {
+struct Batch {
+    const std::function<void(size_t)>* fn;
+    size_t n;
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> done = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    Batch(const std::function<void(size_t)>* fn, size_t n) : fn(fn), n(n) {}
+
+    // Runs calls from the batch until there are none left to claim
+    void work() {
+        size_t i;
+        while ((i = next++) < n) {
+            try {
+                (*fn)(i);
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+            if (++done == n) {
+                std::lock_guard lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+class Pool {
+   public:
+    Pool() {
+        unsigned int n = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 1; i < n; i++) workers.emplace_back([this] { run(); });
+    }
+
+    ~Pool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    void submit(const std::shared_ptr<Batch>& batch, size_t helpers) {
+        if (helpers == 0) return;
+        {
+            std::lock_guard lock(mutex);
+            for (size_t i = 0; i < helpers; i++) queue.push_back(batch);
+        }
+        available.notify_all();
+    }
+
+   private:
+    std::vector<std::thread> workers;
+    std::deque<std::shared_ptr<Batch>> queue;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+    void run() {
+        while (true) {
+            std::shared_ptr<Batch> batch;
+            {
+                std::unique_lock lock(mutex);
+                available.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                batch = std::move(queue.front());
+                queue.pop_front();
+            }
+            batch->work();
+        }
+    }
+};
+
+Pool& pool() {
+    static Pool instance;
+    return instance;
+}
+}  // namespace
+
+size_t size() { return pool().size(); }
+
+void parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+    if (n == 1 || size() == 1) {
+        for (size_t i = 0; i < n; i++) fn(i);
+        return;
+    }
+
+    auto batch = std::make_shared<Batch>(&fn, n);
+    pool().submit(batch, std::min(n, size()) - 1);
+    batch->work();
+
+    std::unique_lock lock(batch->mutex);
+    batch->finished.wait(lock, [&] { return batch->done == n; });
+    if (batch->error) std::rethrow_exception(batch->error);
+}
+
+void parallelInvoke(const std::vector<std::function<void()>>& tasks) {
+    parallelFor(tasks.size(), [&tasks](size_t i) { tasks[i](); });
+}
+}  // namespace threadPool
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace threadPool {
+
+// Number of threads taking part in a parallelFor, including the calling thread.
+size_t size();
+
+// Runs fn(i) for every i in [0, n) on the shared worker pool and returns when all calls are done. The calling thread
+// takes part in the work, so parallelFor may be called from within another parallelFor without deadlocking. If any
+// call throws, the first exception is rethrown here once all calls have finished.
+void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+// Runs every task on the worker pool at the same time, for independent stages of work. Same rules as parallelFor.
+void parallelInvoke(const std::vector<std::function<void()>>& tasks);
+}  // namespace threadPool
@@ -0,0 +1,461 @@
+// Binary snapshots of a Timetable, so that the server does not have to parse and sort the GTFS feeds on every start.
+//
+// A snapshot is a header followed by the tables of the timetable, one after another. Everything is stored by value or
+// by id, never as a pointer, so a snapshot can be read from wherever it is mapped. Tables of trivially copyable values
+// like the departures and events are stored as raw arrays, aligned for their type. The columns of the timetable point
+// into the mapping instead of copying them out, as the copy took most of the load, and the loaded timetable keeps the
+// mapping open. The smaller tables that are kept in other containers are copied.
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "csvLoader.h"
+#include "routing.h"
+
+namespace routing {
+
+namespace {
+constexpr char snapshotMagic[8] = {'H', 'E', 'R', 'M', 'E', 'S', 'T', 'T'};
+
+// Feeds are loaded in parallel, so a line is written in one go to not be mixed with the lines of other feeds
+void logLine(std::ostream& stream, const std::string& line) { stream << line + "\n" << std::flush; }
+
+// Bump whenever the layout below or of any of the stored structs changes, or what is built from the same feed does
+constexpr uint32_t snapshotVersion = 8;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t feedChecksum;
+    // Guards against struct changes without a version bump
+    uint32_t departureSize;
+    uint32_t eventSize;
+    uint32_t tripSize;
+    uint32_t edgeSize;
+    uint32_t routeSize;
+};
+
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+class SnapshotWriter {
+   public:
+    template <typename T>
+    void value(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        data.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    // Takes a std::vector or a Column. The values start at a multiple of their alignment, see SnapshotReader::view.
+    template <typename C>
+    void array(const C& values) {
+        using T = typename C::value_type;
+        static_assert(std::is_trivially_copyable_v<T>);
+        value<uint64_t>(values.size());
+        data.append((alignof(T) - data.size() % alignof(T)) % alignof(T), '\0');
+        data.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void string(std::string_view str) {
+        value<uint64_t>(str.size());
+        data.append(str);
+    }
+
+    std::string data;
+};
+
+// Reads values back in the order they were written. Reading past the end sets failed and returns zeroes, so that a
+// truncated snapshot is rejected instead of read out of bounds.
+class SnapshotReader {
+   public:
+    explicit SnapshotReader(std::string_view data) : data(data) {}
+
+    template <typename T>
+    T value() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T v{};
+        if (!take(sizeof(T))) return v;
+        std::memcpy(&v, data.data() + pos - sizeof(T), sizeof(T));
+        return v;
+    }
+
+    // An array in place. The data must be mapped at an address aligned for T, which mmap and allocations are.
+    template <typename T>
+    std::span<const T> view() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto n = value<uint64_t>();
+        take((alignof(T) - pos % alignof(T)) % alignof(T));
+        if (failed || n > (data.size() - pos) / sizeof(T) || !take(n * sizeof(T))) {
+            failed = true;
+            return {};
+        }
+        return {reinterpret_cast<const T*>(data.data() + pos - n * sizeof(T)), n};
+    }
+
+    template <typename T>
+    std::vector<T> array() {
+        auto values = view<T>();
+        return {values.begin(), values.end()};
+    }
+
+    template <typename T>
+    void column(Column<T>& values) {
+        values.map(view<T>());
+    }
+
+    std::string_view string() {
+        auto n = value<uint64_t>();
+        if (!take(n)) return {};
+        return data.substr(pos - n, n);
+    }
+
+    // Number of entries in a table, checked against the bytes left so a broken count cannot make us allocate wildly
+    size_t count() {
+        auto n = value<uint64_t>();
+        if (n > data.size() - pos) failed = true;
+        return failed ? 0 : n;
+    }
+
+    bool failed = false;
+
+   private:
+    bool take(size_t n) {
+        if (failed || n > data.size() - pos) {
+            failed = true;
+            return false;
+        }
+        pos += n;
+        return true;
+    }
+
+    std::string_view data;
+    size_t pos = 0;
+};
+
+struct ShapePoint {
+    double distance;
+    double latitude;
+    double longitude;
+};
+
+struct ServicePattern {
+    ServiceId service;
+    CalendarIdx pattern;
+};
+
+uint32_t crc(uint32_t crc, std::string_view data) {
+    return crc32_z(crc, reinterpret_cast<const Bytef*>(data.data()), data.size());
+}
+}  // namespace
+
+uint64_t Timetable::feedChecksum(const std::string& gtfsPath) {
+    // Only the files a Timetable is built from, as data/raw also holds other large files
+    static const char* const feedFiles[] = {"calendar.txt",   "calendar_dates.txt", "feed_info.txt",
+                                            "routes.txt",     "shapes.txt",         "stop_times.txt",
+                                            "stops.txt",      "transfers.txt",      "trips.txt"};
+
+    std::vector<std::filesystem::path> files;
+    if (std::filesystem::is_directory(gtfsPath)) {
+        for (const char* name : feedFiles) files.push_back(std::filesystem::path(gtfsPath) / name);
+    } else {
+        files.emplace_back(gtfsPath);
+    }
+
+    // CRC-32 of the names and contents of the files, and their total size in the upper half
+    uint32_t checksum = 0;
+    uint64_t size = 0;
+    for (const auto& path : files) {
+        csvLoader::MappedFile file(path.string());
+        if (!file.isOpen()) continue;
+        checksum = crc(crc(checksum, path.filename().string()), file.view());
+        size += file.view().size();
+    }
+    return size << 32 | checksum;
+}
+
+bool Timetable::saveSnapshot(const std::string& path, uint64_t feedChecksum) const {
+    SnapshotWriter out;
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.byteOrder = byteOrderMark;
+    header.feedChecksum = feedChecksum;
+    header.departureSize = sizeof(Departure);
+    header.eventSize = sizeof(StopEvent);
+    header.tripSize = sizeof(Trip);
+    header.edgeSize = sizeof(Edge);
+    header.routeSize = sizeof(Route);
+    out.value(header);
+
+    out.string(name);
+    out.value(startDate);
+    out.value(endDate);
+
+    // Strings are interned again in id order when loading, which gives them the same ids
+    out.value<uint64_t>(strings.size());
+    for (StringId id = 1; id < strings.size(); id++) out.string(strings[id]);
+
+    // Stops and trips are stored in index order, so their indices do not have to be stored
+    out.value<uint64_t>(stops.size());
+    for (const StopNode& stop : stops) {
+        out.value(stop.stopId);
+        out.value(stop.name);
+        out.value(stop.lat);
+        out.value(stop.lon);
+        out.value(stop.minTransferTime);
+
+        out.value<uint64_t>(stop.transfersType1.size());
+        for (const auto& [fromTrip, toTrips] : stop.transfersType1) {
+            out.value(fromTrip);
+            out.array(toTrips);
+        }
+        out.array(stop.transfersType2);
+    }
+
+    out.array(trips);
+    out.array(departureOffsets);
+    out.array(departures);
+    out.array(eventOffsets);
+    out.array(events);
+    out.array(eventShapeDistTravelled);
+    out.array(eventStopPoints);
+    out.array(eventHeadsigns);
+
+    out.array(routePatterns);
+    out.array(patternStops);
+    out.array(patternTrips);
+    out.array(patternTimes);
+    out.array(stopPatternOffsets);
+    out.array(stopPatterns);
+
+    out.value(calendar.firstDate);
+    out.value(calendar.lastDate);
+    out.value(calendar.firstDay);
+    out.value(calendar.days);
+    out.value(calendar.wordsPerPattern);
+    out.array(calendar.bits);
+    std::vector<ServicePattern> servicePatterns;
+    servicePatterns.reserve(calendar.patterns.size());
+    for (const auto& [service, pattern] : calendar.patterns) servicePatterns.push_back({service, pattern});
+    out.array(servicePatterns);
+
+    std::vector<Route> routeList;
+    routeList.reserve(routes.size());
+    for (const auto& [routeId, route] : routes) routeList.push_back(route);
+    out.array(routeList);
+
+    // Shapes are written encoded, as they are kept in memory
+    out.array(shapes.ids);
+    out.array(shapes.offsets);
+    out.array(shapes.data);
+
+    out.value<uint64_t>(stopPoints.size());
+    for (const auto& [stopId, coord] : stopPoints) {
+        out.value(stopId);
+        out.value(ShapePoint{0, coord.latitude, coord.longitude});
+    }
+
+    // Write to a temporary file and rename it, so that a snapshot is never seen half written. The file is named after
+    // the process and thread, so that writers of the same snapshot do not write into each other's file.
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::string tmpPath = path + "." + std::to_string(getpid()) + "." +
+                          std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            logLine(std::cerr, "[ERROR!] Could not write snapshot " + tmpPath);
+            return false;
+        }
+        file.write(out.data.data(), static_cast<std::streamsize>(out.data.size()));
+        if (!file) {
+            logLine(std::cerr, "[ERROR!] Could not write snapshot " + tmpPath);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        logLine(std::cerr, "[ERROR!] Could not write snapshot " + path + ": " + ec.message());
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Timetable> Timetable::loadSnapshot(const std::string& path, uint64_t feedChecksum) {
+    auto file = std::make_shared<const csvLoader::MappedFile>(path);
+    if (!file->isOpen()) return nullptr;
+    SnapshotReader in(file->view());
+
+    auto header = in.value<SnapshotHeader>();
+    if (in.failed || std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+        header.version != snapshotVersion || header.byteOrder != byteOrderMark || header.feedChecksum != feedChecksum ||
+        header.departureSize != sizeof(Departure) || header.eventSize != sizeof(StopEvent) ||
+        header.tripSize != sizeof(Trip) || header.edgeSize != sizeof(Edge) || header.routeSize != sizeof(Route)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Timetable> tt(new Timetable());
+    tt->snapshotFile = file;
+    tt->name = in.string();
+    tt->startDate = in.value<gtfs::Date>();
+    tt->endDate = in.value<gtfs::Date>();
+
+    size_t stringCount = in.count();
+    for (size_t i = 1; i < stringCount && !in.failed; i++) {
+        if (tt->strings.intern(in.string()) != i) in.failed = true;
+    }
+
+    size_t stopCount = in.count();
+    tt->stops.reserve(stopCount);
+    for (size_t i = 0; i < stopCount && !in.failed; i++) {
+        StopNode& stop = tt->stops.emplace_back();
+        stop.index = static_cast<StopIdx>(i);
+        stop.stopId = in.value<StopId>();
+        stop.name = in.value<StringId>();
+        stop.lat = in.value<float>();
+        stop.lon = in.value<float>();
+        stop.minTransferTime = in.value<int32_t>();
+
+        size_t type1Count = in.count();
+        for (size_t j = 0; j < type1Count && !in.failed; j++) {
+            auto fromTrip = in.value<TripIdx>();
+            stop.transfersType1[fromTrip] = in.array<TripIdx>();
+        }
+        stop.transfersType2 = in.array<Edge>();
+        tt->stopIndex.emplace(stop.stopId, stop.index);
+    }
+
+    tt->trips = in.array<Trip>();
+    for (TripIdx i = 1; i < tt->trips.size(); i++) tt->tripIndex.emplace(tt->trips[i].tripId, i);
+
+    in.column(tt->departureOffsets);
+    in.column(tt->departures);
+    in.column(tt->eventOffsets);
+    in.column(tt->events);
+    in.column(tt->eventShapeDistTravelled);
+    in.column(tt->eventStopPoints);
+    in.column(tt->eventHeadsigns);
+
+    in.column(tt->routePatterns);
+    in.column(tt->patternStops);
+    in.column(tt->patternTrips);
+    in.column(tt->patternTimes);
+    in.column(tt->stopPatternOffsets);
+    in.column(tt->stopPatterns);
+
+    // Indices are used without bounds checks when routing, so make sure they are all in range
+    size_t tripCount = tt->trips.size();
+    auto validTrip = [&](TripIdx trip) { return trip < tripCount; };
+    auto validOffsets = [](std::span<const uint32_t> offsets, size_t count, size_t total) {
+        return offsets.size() == count + 1 && offsets.front() == 0 && offsets.back() == total &&
+               std::is_sorted(offsets.begin(), offsets.end());
+    };
+    auto validString = [&](StringId id) { return id < tt->strings.size(); };
+    for (const StopNode& stop : tt->stops) {
+        in.failed |= !validString(stop.name);
+        for (const auto& [fromTrip, toTrips] : stop.transfersType1) {
+            in.failed |= !validTrip(fromTrip) || !std::all_of(toTrips.begin(), toTrips.end(), validTrip);
+        }
+        for (const Edge& edge : stop.transfersType2) in.failed |= edge.to >= stopCount || !validTrip(edge.trip);
+    }
+    in.failed |= !validOffsets(tt->departureOffsets, stopCount, tt->departures.size()) ||
+                 !validOffsets(tt->eventOffsets, tripCount, tt->events.size()) ||
+                 tt->eventShapeDistTravelled.size() != tt->events.size() ||
+                 tt->eventStopPoints.size() != tt->events.size() || tt->eventHeadsigns.size() != tt->events.size();
+    if (!in.failed) {
+        for (const Departure& departure : tt->departures) {
+            in.failed |= !validTrip(departure.trip) || departure.stopSequence < 1 ||
+                         static_cast<size_t>(departure.stopSequence) > tt->tripEvents(departure.trip).size();
+        }
+        for (const StopEvent& event : tt->events) in.failed |= event.stop >= stopCount;
+        in.failed |= !std::all_of(tt->eventHeadsigns.begin(), tt->eventHeadsigns.end(), validString);
+
+        size_t patternCount = tt->routePatterns.size();
+        for (const RoutePattern& p : tt->routePatterns) {
+            in.failed |= uint64_t{p.firstStop} + p.stopCount > tt->patternStops.size() ||
+                         uint64_t{p.firstTrip} + p.tripCount > tt->patternTrips.size() ||
+                         uint64_t{p.firstTime} + uint64_t{p.stopCount} * p.tripCount > tt->patternTimes.size();
+        }
+        for (StopIdx stop : tt->patternStops) in.failed |= stop >= stopCount;
+        for (TripIdx trip : tt->patternTrips) in.failed |= !validTrip(trip);
+        for (const Trip& trip : tt->trips) in.failed |= trip.pattern != NO_PATTERN && trip.pattern >= patternCount;
+        in.failed |= !validOffsets(tt->stopPatternOffsets, stopCount, tt->stopPatterns.size());
+        for (const PatternStop& ps : tt->stopPatterns) {
+            in.failed |= ps.pattern >= patternCount;
+            if (!in.failed) in.failed |= ps.position >= tt->routePatterns[ps.pattern].stopCount;
+        }
+    }
+
+    ServiceCalendar& calendar = tt->calendar;
+    calendar.firstDate = in.value<int32_t>();
+    calendar.lastDate = in.value<int32_t>();
+    calendar.firstDay = in.value<int32_t>();
+    calendar.days = in.value<int32_t>();
+    calendar.wordsPerPattern = in.value<uint32_t>();
+    calendar.bits = in.array<uint64_t>();
+    for (const ServicePattern& sp : in.array<ServicePattern>()) calendar.patterns.emplace(sp.service, sp.pattern);
+    in.failed |= calendar.wordsPerPattern == 0 || calendar.bits.size() % calendar.wordsPerPattern != 0 ||
+                 calendar.days < 0 || static_cast<uint64_t>(calendar.days) > uint64_t{calendar.wordsPerPattern} * 64;
+    if (!in.failed) {
+        size_t patternCount = calendar.patternCount();
+        for (const auto& [service, pattern] : calendar.patterns) in.failed |= pattern >= patternCount;
+        for (const Trip& trip : tt->trips) in.failed |= trip.calendar >= patternCount;
+    }
+
+    for (const Route& route : in.array<Route>()) {
+        in.failed |= !validString(route.routeShortName) || !validString(route.routeLongName);
+        tt->routes[route.routeId] = route;
+    }
+
+    ShapeStore& shapes = tt->shapes;
+    shapes.ids = in.array<ShapeId>();
+    shapes.offsets = in.array<uint32_t>();
+    shapes.data = in.array<uint8_t>();
+    in.failed |= shapes.offsets.size() != shapes.ids.size() + 1 || shapes.offsets.front() != 0 ||
+                 shapes.offsets.back() != shapes.data.size() || !std::ranges::is_sorted(shapes.offsets) ||
+                 std::adjacent_find(shapes.ids.begin(), shapes.ids.end(), std::greater_equal<>()) != shapes.ids.end();
+    // The last byte must end a number, so decoding never reads past the data
+    in.failed |= !shapes.data.empty() && (shapes.data.back() & 0x80);
+
+    size_t stopPointCount = in.count();
+    tt->stopPoints.reserve(stopPointCount);
+    for (size_t i = 0; i < stopPointCount && !in.failed; i++) {
+        auto stopId = in.value<StopId>();
+        auto p = in.value<ShapePoint>();
+        tt->stopPoints[stopId] = DMSCoord(p.latitude, p.longitude);
+    }
+
+    if (in.failed) {
+        logLine(std::cerr, "[ERROR!] Snapshot " + path + " is broken, ignoring it");
+        return nullptr;
+    }
+    return tt;
+}
+
+std::unique_ptr<Timetable> Timetable::load(const std::string& gtfsPath, const std::string& cacheDir) {
+    // data/gtfs/vt and data/gtfs/vt.zip get data/caches/vt.tt and data/caches/vt.zip.tt, as their checksums differ
+    std::filesystem::path feed(gtfsPath);
+    if (!feed.has_filename()) feed = feed.parent_path();
+    std::string snapshotPath = (std::filesystem::path(cacheDir) / feed.filename()).string() + ".tt";
+
+    uint64_t checksum = feedChecksum(gtfsPath);
+    if (auto tt = loadSnapshot(snapshotPath, checksum)) return tt;
+
+    logLine(std::cout, "No up to date snapshot in " + snapshotPath + ", building timetable from " + gtfsPath);
+    std::unique_ptr<Timetable> tt(new Timetable(gtfsPath));
+    tt->saveSnapshot(snapshotPath, checksum);
+    return tt;
+}
+}  // namespace routing
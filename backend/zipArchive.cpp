@@ -0,0 +1,220 @@
+#include "zipArchive.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <iostream>
+
+namespace zip {
+
+namespace {
+constexpr uint32_t localHeaderSignature = 0x04034b50;
+constexpr uint32_t centralHeaderSignature = 0x02014b50;
+constexpr uint32_t endOfCentralDirectorySignature = 0x06054b50;
+constexpr uint32_t zip64LocatorSignature = 0x07064b50;
+constexpr uint32_t zip64EndSignature = 0x06064b50;
+
+constexpr size_t localHeaderSize = 30;
+constexpr size_t centralHeaderSize = 46;
+constexpr size_t endOfCentralDirectorySize = 22;
+constexpr size_t zip64LocatorSize = 20;
+constexpr size_t zip64EndSize = 56;
+
+constexpr uint16_t methodStored = 0;
+constexpr uint16_t methodDeflated = 8;
+constexpr uint16_t flagEncrypted = 1;
+
+// Zip files are little endian
+uint64_t readLE(const char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = value << 8 | static_cast<unsigned char>(p[i]);
+    return value;
+}
+
+uint16_t read16(const char* p) { return static_cast<uint16_t>(readLE(p, 2)); }
+uint32_t read32(const char* p) { return static_cast<uint32_t>(readLE(p, 4)); }
+uint64_t read64(const char* p) { return readLE(p, 8); }
+
+// Fills in the 64 bit sizes and offset of entry from the zip64 extra field, for the fields which are saturated in the
+// central header
+void applyZip64Extra(Entry& entry, std::string_view extra) {
+    while (extra.size() >= 4) {
+        uint16_t id = read16(extra.data());
+        uint16_t length = read16(extra.data() + 2);
+        if (extra.size() < 4 + size_t{length}) return;
+
+        if (id == 0x0001) {
+            std::string_view field = extra.substr(4, length);
+            for (uint64_t* value : {&entry.size, &entry.compressedSize, &entry.localHeaderOffset}) {
+                if (*value != UINT32_MAX) continue;
+                if (field.size() < 8) return;
+                *value = read64(field.data());
+                field.remove_prefix(8);
+            }
+            return;
+        }
+        extra.remove_prefix(4 + length);
+    }
+}
+}  // namespace
+
+Archive::Archive(const std::string& path) : file(path) {
+    if (!file.isOpen()) return;
+    std::string_view data = file.view();
+    if (data.size() < endOfCentralDirectorySize) return;
+
+    // The end of central directory record is followed by a comment of at most 64 KiB, so search backwards for it
+    size_t eocd = data.size() - endOfCentralDirectorySize;
+    size_t searchEnd = eocd > 0xffff ? eocd - 0xffff : 0;
+    while (read32(data.data() + eocd) != endOfCentralDirectorySignature) {
+        if (eocd == searchEnd) return;
+        eocd--;
+    }
+
+    uint64_t count = read16(data.data() + eocd + 10);
+    uint64_t directorySize = read32(data.data() + eocd + 12);
+    uint64_t directoryOffset = read32(data.data() + eocd + 16);
+
+    if (eocd >= zip64LocatorSize && read32(data.data() + eocd - zip64LocatorSize) == zip64LocatorSignature) {
+        uint64_t zip64End = read64(data.data() + eocd - zip64LocatorSize + 8);
+        if (data.size() < zip64EndSize || zip64End > data.size() - zip64EndSize ||
+            read32(data.data() + zip64End) != zip64EndSignature) return;
+        count = read64(data.data() + zip64End + 32);
+        directorySize = read64(data.data() + zip64End + 40);
+        directoryOffset = read64(data.data() + zip64End + 48);
+    }
+
+    if (directoryOffset > data.size() || directorySize > data.size() - directoryOffset) return;
+    std::string_view directory = data.substr(directoryOffset, directorySize);
+
+    members.reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+        if (directory.size() < centralHeaderSize || read32(directory.data()) != centralHeaderSignature) return;
+        const char* h = directory.data();
+        size_t nameLength = read16(h + 28);
+        size_t extraLength = read16(h + 30);
+        size_t commentLength = read16(h + 32);
+        size_t headerLength = centralHeaderSize + nameLength + extraLength + commentLength;
+        if (directory.size() < headerLength) return;
+
+        Entry& entry = members.emplace_back();
+        entry.flags = read16(h + 8);
+        entry.method = read16(h + 10);
+        entry.crc = read32(h + 16);
+        entry.compressedSize = read32(h + 20);
+        entry.size = read32(h + 24);
+        entry.localHeaderOffset = read32(h + 42);
+        entry.name = directory.substr(centralHeaderSize, nameLength);
+        applyZip64Extra(entry, directory.substr(centralHeaderSize + nameLength, extraLength));
+
+        directory.remove_prefix(headerLength);
+    }
+
+    open = true;
+}
+
+const Entry* Archive::find(std::string_view name) const {
+    auto it = std::find_if(members.begin(), members.end(), [&](const Entry& e) { return e.name == name; });
+    return it == members.end() ? nullptr : &*it;
+}
+
+std::string_view Archive::rawData(const Entry& entry) const {
+    std::string_view data = file.view();
+    if (data.size() < localHeaderSize || entry.localHeaderOffset > data.size() - localHeaderSize) return {};
+    const char* h = data.data() + entry.localHeaderOffset;
+    if (read32(h) != localHeaderSignature) return {};
+
+    // The local header has its own name and extra field, which may differ in length from the central directory's
+    uint64_t start = entry.localHeaderOffset + localHeaderSize + read16(h + 26) + read16(h + 28);
+    if (start > data.size() || entry.compressedSize > data.size() - start) return {};
+    return data.substr(start, entry.compressedSize);
+}
+
+struct Reader::Inflater {
+    z_stream stream{};
+};
+
+Reader::Reader(const Archive& archive, const Entry& entry) : entry(entry), input(archive.rawData(entry)) {
+    if ((entry.flags & flagEncrypted) || (input.empty() && entry.compressedSize > 0)) {
+        error = true;
+        return;
+    }
+
+    if (entry.method == methodStored) {
+        uint32_t storedCrc = crc32_z(0, reinterpret_cast<const Bytef*>(input.data()), input.size());
+        error = input.size() != entry.size || storedCrc != entry.crc;
+        return;
+    }
+
+    if (entry.method != methodDeflated) {
+        error = true;
+        return;
+    }
+
+    inflater = std::make_unique<Inflater>();
+    // Negative window bits: raw deflate data without a zlib header, which is what zip members contain
+    if (inflateInit2(&inflater->stream, -MAX_WBITS) != Z_OK) {
+        inflater.reset();
+        error = true;
+    }
+}
+
+Reader::~Reader() {
+    if (inflater) inflateEnd(&inflater->stream);
+}
+
+std::string_view Reader::stored() const { return entry.method == methodStored && !error ? input : std::string_view{}; }
+
+size_t Reader::read(std::string& out, size_t n) {
+    if (error || !inflater || produced == entry.size) return 0;
+    n = std::min<size_t>(n, UINT_MAX);
+
+    z_stream& stream = inflater->stream;
+    size_t offset = out.size();
+    out.resize(offset + n);
+    stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+    stream.avail_out = static_cast<uInt>(n);
+
+    int status = Z_OK;
+    while (stream.avail_out > 0 && status == Z_OK) {
+        if (stream.avail_in == 0) {
+            size_t chunk = std::min<size_t>(input.size(), UINT_MAX);
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            stream.avail_in = static_cast<uInt>(chunk);
+            input.remove_prefix(chunk);
+        }
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_BUF_ERROR && stream.avail_in == 0 && input.empty()) break;
+    }
+
+    size_t got = n - stream.avail_out;
+    out.resize(offset + got);
+    crc = crc32_z(crc, reinterpret_cast<const Bytef*>(out.data() + offset), got);
+    produced += got;
+
+    bool truncated = status != Z_OK && status != Z_STREAM_END;
+    bool finished = status == Z_STREAM_END || produced >= entry.size;
+    if (truncated || (finished && (produced != entry.size || crc != entry.crc))) {
+        std::cerr << "[ERROR!] Zip member " << entry.name << " is corrupt" << std::endl;
+        error = true;
+        out.resize(offset);
+        return 0;
+    }
+    return got;
+}
+
+bool splitPath(const std::string& path, std::string& archive, std::string& member) {
+    for (size_t pos = path.find(".zip/"); pos != std::string::npos; pos = path.find(".zip/", pos + 1)) {
+        std::string candidate = path.substr(0, pos + 4);
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(candidate, ec)) {
+            archive = std::move(candidate);
+            member = path.substr(pos + 5);
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace zip
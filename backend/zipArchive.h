@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csvLoader.h"
+
+namespace zip {
+
+struct Entry {
+    std::string name;
+    uint16_t flags;
+    uint16_t method;
+    uint32_t crc;
+    uint64_t compressedSize;
+    uint64_t size;
+    uint64_t localHeaderOffset;
+};
+
+// A zip file opened for reading. The file is memory mapped and only the central directory is parsed up front, members
+// are read with a Reader.
+class Archive {
+   public:
+    explicit Archive(const std::string& path);
+
+    [[nodiscard]] bool isOpen() const { return open; }
+    [[nodiscard]] const std::vector<Entry>& entries() const { return members; }
+    [[nodiscard]] const Entry* find(std::string_view name) const;
+
+    // The compressed bytes of entry, or an empty view if its local header is broken
+    [[nodiscard]] std::string_view rawData(const Entry& entry) const;
+
+   private:
+    csvLoader::MappedFile file;
+    std::vector<Entry> members;
+    bool open = false;
+};
+
+// Reads one member of an archive from start to end. Stored members are handed out directly from the mapping, deflated
+// members are inflated a block at a time so the whole member never has to be held in memory.
+class Reader {
+   public:
+    Reader(const Archive& archive, const Entry& entry);
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // Appends up to n bytes of the member to out and returns how many were appended. Returns 0 at the end of the member
+    // or on error, see failed().
+    size_t read(std::string& out, size_t n);
+
+    // Set if the member is encrypted, uses an unsupported compression method, is corrupt or fails its CRC check
+    [[nodiscard]] bool failed() const { return error; }
+
+    // For stored members, the whole member. Empty for deflated members.
+    [[nodiscard]] std::string_view stored() const;
+
+   private:
+    struct Inflater;
+
+    const Entry& entry;
+    std::string_view input;
+    std::unique_ptr<Inflater> inflater;
+    uint32_t crc = 0;
+    uint64_t produced = 0;
+    bool error = false;
+};
+
+// Splits a path like "data/gtfs/feed.zip/stops.txt" into the archive and the member name. Returns false if no parent
+// directory of path is a regular file ending with .zip.
+bool splitPath(const std::string& path, std::string& archive, std::string& member);
+}  // namespace zip